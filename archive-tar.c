@@ -132,17 +132,18 @@ static int stream_blocked(struct repository *r, const struct object_id *oid)
 	struct git_istream *st;
 	enum object_type type;
 	unsigned long sz;
-	char buf[BLOCKSIZE];
 	ssize_t readlen;
 
 	st = open_istream(r, oid, &type, &sz, NULL);
 	if (!st)
 		return error(_("cannot stream blob %s"), oid_to_hex(oid));
 	for (;;) {
-		readlen = read_istream(st, buf, sizeof(buf));
+		/* inflate straight into the block we are about to write */
+		readlen = read_istream(st, block + offset, BLOCKSIZE - offset);
 		if (readlen <= 0)
 			break;
-		do_write_blocked(buf, readlen);
+		offset += readlen;
+		write_if_needed();
 	}
 	close_istream(st);
 	if (!readlen)
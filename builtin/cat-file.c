@@ -17,6 +17,7 @@
 #include "streaming.h"
 #include "oid-array.h"
 #include "packfile.h"
+#include "pack-revindex.h"
 #include "object-file.h"
 #include "object-name.h"
 #include "object-store-ll.h"
@@ -38,6 +39,8 @@ struct batch_options {
 	int buffer_output;
 	int all_objects;
 	int unordered;
+	int prefetch;
+	int compressed;
 	int transform_mode; /* may be 'w' or 'c' for --filters or --textconv */
 	char input_delim;
 	char output_delim;
@@ -281,6 +284,18 @@ struct expand_data {
 	const char *rest;
 	struct object_id delta_base_oid;
 
+	/*
+	 * With --compressed, the zlib stream to show as the contents of
+	 * the object: either "compressed_len" bytes of "compressed_pack"
+	 * starting at "compressed_offset", or "compressed_buf" if the
+	 * object is not stored that way and we had to deflate it.
+	 */
+	struct packed_git *compressed_pack;
+	off_t compressed_offset;
+	void *compressed_buf;
+	size_t compressed_len;
+	int want_compressed_len;
+
 	/*
 	 * If mark_query is true, we do not expand anything, but rather
 	 * just mark the object_info with items we wish to query.
@@ -336,6 +351,12 @@ static int expand_atom(struct strbuf *sb, const char *atom, int len,
 			data->info.disk_sizep = &data->disk_size;
 		else
 			strbuf_addf(sb, "%"PRIuMAX, (uintmax_t)data->disk_size);
+	} else if (is_atom("objectsize:compressed", atom, len)) {
+		if (data->mark_query)
+			data->want_compressed_len = 1;
+		else
+			strbuf_addf(sb, "%"PRIuMAX,
+				    (uintmax_t)data->compressed_len);
 	} else if (is_atom("rest", atom, len)) {
 		if (data->mark_query)
 			data->split_on_whitespace = 1;
@@ -444,12 +465,119 @@ static void print_object_or_die(struct batch_options *opt, struct expand_data *d
 	}
 }
 
+static void *deflate_object(const void *contents, unsigned long size,
+			    size_t *result_size)
+{
+	git_zstream stream;
+	unsigned long bound;
+	unsigned char *deflated;
+
+	git_deflate_init(&stream, zlib_compression_level);
+	bound = git_deflate_bound(&stream, size);
+	deflated = xmalloc(bound);
+	stream.next_out = deflated;
+	stream.avail_out = bound;
+	stream.next_in = (unsigned char *)contents;
+	stream.avail_in = size;
+	while (git_deflate(&stream, Z_FINISH) == Z_OK)
+		; /* nothing */
+	git_deflate_end(&stream);
+	*result_size = stream.total_out;
+	return deflated;
+}
+
+/*
+ * Find the zlib stream to show for --compressed. A non-delta object in a
+ * pack is stored as exactly that, and can be copied out of the pack
+ * as-is. Deltas and loose objects are not (the latter also compress the
+ * object header), so deflate those ourselves.
+ */
+static void prepare_compressed(struct expand_data *data,
+			       struct packed_git *pack, off_t offset)
+{
+	enum object_type type;
+	unsigned long size;
+	void *contents;
+
+	data->compressed_pack = NULL;
+	FREE_AND_NULL(data->compressed_buf);
+
+	if (!pack) {
+		const struct object_id *oid =
+			lookup_replace_object(the_repository, &data->oid);
+		struct pack_entry e;
+
+		if (find_pack_entry(the_repository, oid, &e)) {
+			pack = e.p;
+			offset = e.offset;
+		}
+	}
+	if (pack) {
+		struct pack_window *w_curs = NULL;
+		off_t curpos = offset;
+		uint32_t pos;
+
+		type = unpack_object_header(pack, &w_curs, &curpos, &size);
+		unuse_pack(&w_curs);
+		if (type > OBJ_NONE && type != OBJ_OFS_DELTA &&
+		    type != OBJ_REF_DELTA &&
+		    !offset_to_pack_pos(pack, offset, &pos)) {
+			data->compressed_pack = pack;
+			data->compressed_offset = curpos;
+			data->compressed_len =
+				pack_pos_to_offset(pack, pos + 1) - curpos;
+			return;
+		}
+	}
+
+	contents = repo_read_object_file(the_repository, &data->oid, &type,
+					 &size);
+	if (!contents)
+		die("object %s disappeared", oid_to_hex(&data->oid));
+	data->compressed_buf = deflate_object(contents, size,
+					      &data->compressed_len);
+	free(contents);
+}
+
+static void print_compressed(struct batch_options *opt,
+			     struct expand_data *data)
+{
+	struct pack_window *w_curs = NULL;
+	off_t pos = data->compressed_offset;
+	size_t left = data->compressed_len;
+
+	if (!data->compressed_pack) {
+		batch_write(opt, data->compressed_buf, data->compressed_len);
+		return;
+	}
+
+	/* write straight out of the pack windows */
+	while (left) {
+		unsigned long avail;
+		unsigned char *in = use_pack(data->compressed_pack, &w_curs,
+					     pos, &avail);
+
+		if (avail > left)
+			avail = left;
+		/* batch_write() takes an int */
+		if (avail > INT_MAX)
+			avail = INT_MAX;
+		batch_write(opt, in, avail);
+		pos += avail;
+		left -= avail;
+	}
+	unuse_pack(&w_curs);
+}
+
 static void print_default_format(struct strbuf *scratch, struct expand_data *data,
 				 struct batch_options *opt)
 {
-	strbuf_addf(scratch, "%s %s %"PRIuMAX"%c", oid_to_hex(&data->oid),
-		    type_name(data->type),
-		    (uintmax_t)data->size, opt->output_delim);
+	strbuf_addf(scratch, "%s %s %"PRIuMAX, oid_to_hex(&data->oid),
+		    type_name(data->type), (uintmax_t)data->size);
+	if (opt->compressed && opt->batch_mode == BATCH_MODE_CONTENTS)
+		strbuf_addf(scratch, " %"PRIuMAX,
+			    (uintmax_t)data->compressed_len);
+	strbuf_addch(scratch, opt->output_delim);
 }
 
 /*
@@ -499,6 +627,10 @@ static void batch_object_write(const char *obj_name,
 		}
 	}
 
+	if (opt->compressed &&
+	    (opt->batch_mode == BATCH_MODE_CONTENTS || data->want_compressed_len))
+		prepare_compressed(data, pack, offset);
+
 	strbuf_reset(scratch);
 
 	if (!opt->format) {
@@ -511,9 +643,13 @@ static void batch_object_write(const char *obj_name,
 	batch_write(opt, scratch->buf, scratch->len);
 
 	if (opt->batch_mode == BATCH_MODE_CONTENTS) {
-		print_object_or_die(opt, data);
+		if (opt->compressed)
+			print_compressed(opt, data);
+		else
+			print_object_or_die(opt, data);
 		batch_write(opt, &opt->output_delim, 1);
 	}
+	FREE_AND_NULL(data->compressed_buf);
 }
 
 static void batch_one_object(const char *obj_name,
@@ -667,6 +803,20 @@ static void parse_cmd_info(struct batch_options *opt,
 	batch_one_object(line, output, opt, data);
 }
 
+/*
+ * Start reading "obj_name" from disk in the background if it is spelled
+ * as a full object id; anything else needs to be resolved first, which
+ * we do not want to do out of order.
+ */
+static void prefetch_object_name(const char *obj_name)
+{
+	struct object_id oid;
+	const char *end;
+
+	if (!parse_oid_hex(obj_name, &oid, &end) && (!*end || isspace(*end)))
+		prefetch_packed_object(the_repository, &oid);
+}
+
 static void dispatch_calls(struct batch_options *opt,
 		struct strbuf *output,
 		struct expand_data *data,
@@ -678,8 +828,16 @@ static void dispatch_calls(struct batch_options *opt,
 	if (!opt->buffer_output)
 		die(_("flush is only for --buffer mode"));
 
-	for (i = 0; i < nr; i++)
+	for (i = 0; i < nr && i < opt->prefetch; i++)
+		if (cmd[i].line)
+			prefetch_object_name(cmd[i].line);
+
+	for (i = 0; i < nr; i++) {
+		if (opt->prefetch && i + opt->prefetch < nr &&
+		    cmd[i + opt->prefetch].line)
+			prefetch_object_name(cmd[i + opt->prefetch].line);
 		cmd[i].fn(opt, cmd[i].line, output, data);
+	}
 
 	fflush(stdout);
 }
@@ -771,6 +929,65 @@ static void batch_objects_command(struct batch_options *opt,
 	strbuf_release(&input);
 }
 
+static void batch_one_line(char *line,
+			   struct strbuf *output,
+			   struct batch_options *opt,
+			   struct expand_data *data)
+{
+	if (data->split_on_whitespace) {
+		/*
+		 * Split at first whitespace, tying off the beginning
+		 * of the string and saving the remainder (or NULL) in
+		 * data->rest.
+		 */
+		char *p = strpbrk(line, " \t");
+		if (p) {
+			while (*p && strchr(" \t", *p))
+				*p++ = '\0';
+		}
+		data->rest = p;
+	}
+
+	batch_one_object(line, output, opt, data);
+}
+
+/*
+ * Read up to opt->prefetch lines ahead of the one we are answering, and
+ * start reading the objects they name from disk, so that the disk (or
+ * network filesystem) can work on several of them at once.
+ */
+static void batch_objects_prefetch(struct batch_options *opt,
+				   struct strbuf *output,
+				   struct expand_data *data)
+{
+	struct strbuf input = STRBUF_INIT;
+	char **queue;
+	size_t first = 0, nr = 0;
+
+	ALLOC_ARRAY(queue, opt->prefetch);
+
+	while (strbuf_getdelim_strip_crlf(&input, stdin, opt->input_delim) != EOF) {
+		if (nr == opt->prefetch) {
+			batch_one_line(queue[first], output, opt, data);
+			free(queue[first]);
+			first = (first + 1) % opt->prefetch;
+			nr--;
+		}
+		prefetch_object_name(input.buf);
+		queue[(first + nr++) % opt->prefetch] = strbuf_detach(&input, NULL);
+	}
+
+	while (nr) {
+		batch_one_line(queue[first], output, opt, data);
+		free(queue[first]);
+		first = (first + 1) % opt->prefetch;
+		nr--;
+	}
+
+	free(queue);
+	strbuf_release(&input);
+}
+
 #define DEFAULT_FORMAT "%(objectname) %(objecttype) %(objectsize)"
 
 static int batch_objects(struct batch_options *opt)
@@ -795,6 +1012,8 @@ static int batch_objects(struct batch_options *opt)
 	strbuf_release(&output);
 	if (opt->transform_mode)
 		data.split_on_whitespace = 1;
+	if (data.want_compressed_len && !opt->compressed)
+		die(_("%%(objectsize:compressed) requires --compressed"));
 
 	if (opt->format && !strcmp(opt->format, DEFAULT_FORMAT))
 		opt->format = NULL;
@@ -805,6 +1024,14 @@ static int batch_objects(struct batch_options *opt)
 	if (opt->batch_mode == BATCH_MODE_CONTENTS)
 		data.info.typep = &data.type;
 
+	/*
+	 * Unless we are walking the packs in order, each object we are
+	 * asked about may live anywhere in any of them.
+	 */
+	set_pack_access_pattern(the_repository,
+				opt->all_objects && opt->unordered ?
+				PACK_ACCESS_SEQUENTIAL : PACK_ACCESS_RANDOM);
+
 	if (opt->all_objects) {
 		struct object_cb_data cb;
 		struct object_info empty = OBJECT_INFO_INIT;
@@ -861,24 +1088,14 @@ static int batch_objects(struct batch_options *opt)
 		goto cleanup;
 	}
 
-	while (strbuf_getdelim_strip_crlf(&input, stdin, opt->input_delim) != EOF) {
-		if (data.split_on_whitespace) {
-			/*
-			 * Split at first whitespace, tying off the beginning
-			 * of the string and saving the remainder (or NULL) in
-			 * data.rest.
-			 */
-			char *p = strpbrk(input.buf, " \t");
-			if (p) {
-				while (*p && strchr(" \t", *p))
-					*p++ = '\0';
-			}
-			data.rest = p;
-		}
-
-		batch_one_object(input.buf, &output, opt, &data);
+	if (opt->prefetch) {
+		batch_objects_prefetch(opt, &output, &data);
+		goto cleanup;
 	}
 
+	while (strbuf_getdelim_strip_crlf(&input, stdin, opt->input_delim) != EOF)
+		batch_one_line(input.buf, &output, opt, &data);
+
  cleanup:
 	strbuf_release(&input);
 	strbuf_release(&output);
@@ -944,8 +1161,8 @@ int cmd_cat_file(int argc,
 		N_("git cat-file (--textconv | --filters)\n"
 		   "             [<rev>:<path|tree-ish> | --path=<path|tree-ish> <rev>]"),
 		N_("git cat-file (--batch | --batch-check | --batch-command) [--batch-all-objects]\n"
-		   "             [--buffer] [--follow-symlinks] [--unordered]\n"
-		   "             [--textconv | --filters] [-Z]"),
+		   "             [--buffer [--prefetch=<n>]] [--follow-symlinks] [--unordered]\n"
+		   "             [--textconv | --filters | --compressed] [-Z]"),
 		NULL
 	};
 	const struct option options[] = {
@@ -984,10 +1201,14 @@ int cmd_cat_file(int argc,
 		/* Batch-specific options */
 		OPT_GROUP(N_("Change or optimize batch output")),
 		OPT_BOOL(0, "buffer", &batch.buffer_output, N_("buffer --batch output")),
+		OPT_INTEGER(0, "prefetch", &batch.prefetch,
+			    N_("with --buffer: read <n> objects from disk ahead of the output")),
 		OPT_BOOL(0, "follow-symlinks", &batch.follow_symlinks,
 			 N_("follow in-tree symlinks")),
 		OPT_BOOL(0, "unordered", &batch.unordered,
 			 N_("do not order objects before emitting them")),
+		OPT_BOOL(0, "compressed", &batch.compressed,
+			 N_("emit object contents as a zlib stream")),
 		/* Textconv options, stand-ole*/
 		OPT_GROUP(N_("Emit object (blob or tree) with conversion or filter (stand-alone, or with batch)")),
 		OPT_CMDMODE(0, "textconv", &opt,
@@ -1030,6 +1251,12 @@ int cmd_cat_file(int argc,
 	else if (batch.buffer_output >= 0)
 		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
 			       "--buffer");
+	else if (batch.prefetch)
+		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
+			       "--prefetch");
+	else if (batch.compressed)
+		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
+			       "--compressed");
 	else if (batch.all_objects)
 		usage_msg_optf(_("'%s' requires a batch mode"), usage, options,
 			       "--batch-all-objects");
@@ -1050,6 +1277,16 @@ int cmd_cat_file(int argc,
 	if (batch.buffer_output < 0)
 		batch.buffer_output = batch.all_objects;
 
+	if (batch.prefetch < 0)
+		usage_msg_opt(_("'--prefetch' must be non-negative"),
+			      usage, options);
+	if (batch.prefetch && !batch.buffer_output)
+		usage_msg_optf(_("'%s' requires '%s'"), usage, options,
+			       "--prefetch", "--buffer");
+	if (batch.prefetch && batch.all_objects)
+		usage_msg_optf(_("options '%s' and '%s' cannot be used together"),
+			       usage, options, "--prefetch", "--batch-all-objects");
+
 	prepare_repo_settings(the_repository);
 	the_repository->settings.command_requires_full_index = 0;
 
@@ -1064,6 +1301,10 @@ int cmd_cat_file(int argc,
 			usage_msg_opt(_("batch modes take no arguments"), usage,
 				      options);
 
+		die_for_incompatible_opt3(batch.compressed, "--compressed",
+					  opt_cw, opt == 'c' ? "--textconv" : "--filters",
+					  use_mailmap, "--use-mailmap");
+
 		return batch_objects(&batch);
 	}
 
@@ -19,7 +19,8 @@
 #define BUILTIN_COMMIT_GRAPH_WRITE_USAGE \
 	N_("git commit-graph write [--object-dir <dir>] [--append]\n" \
 	   "                       [--split[=<strategy>]] [--reachable | --stdin-packs | --stdin-commits]\n" \
-	   "                       [--changed-paths] [--[no-]max-new-filters <n>] [--[no-]progress]\n" \
+	   "                       [--changed-paths] [--[no-]max-new-filters <n>]\n" \
+	   "                       [--[no-]max-new-filter-time <ms>] [--[no-]progress]\n" \
 	   "                       <split-options>")
 
 static const char * builtin_commit_graph_verify_usage[] = {
@@ -196,7 +197,7 @@ static int write_option_max_new_filters(const struct option *opt,
 		*to = strtol(arg, (char **)&s, 10);
 		if (*s)
 			return error(_("option `%s' expects a numerical value"),
-				     "max-new-filters");
+				     opt->long_name);
 	}
 	return 0;
 }
@@ -207,6 +208,8 @@ static int git_commit_graph_write_config(const char *var, const char *value,
 {
 	if (!strcmp(var, "commitgraph.maxnewfilters"))
 		write_opts.max_new_filters = git_config_int(var, value, ctx->kvi);
+	else if (!strcmp(var, "commitgraph.maxnewfiltertime"))
+		write_opts.max_new_filter_time = git_config_int(var, value, ctx->kvi);
 	/*
 	 * No need to fall-back to 'git_default_config', since this was already
 	 * called in 'cmd_commit_graph()'.
@@ -248,6 +251,9 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 		OPT_CALLBACK_F(0, "max-new-filters", &write_opts.max_new_filters,
 			NULL, N_("maximum number of changed-path Bloom filters to compute"),
 			0, write_option_max_new_filters),
+		OPT_CALLBACK_F(0, "max-new-filter-time", &write_opts.max_new_filter_time,
+			NULL, N_("maximum milliseconds to spend computing changed-path Bloom filters"),
+			0, write_option_max_new_filters),
 		OPT_BOOL(0, "progress", &opts.progress,
 			 N_("force progress reporting")),
 		OPT_END(),
@@ -260,6 +266,7 @@ static int graph_write(int argc, const char **argv, const char *prefix)
 	write_opts.max_commits = 0;
 	write_opts.expire_time = 0;
 	write_opts.max_new_filters = -1;
+	write_opts.max_new_filter_time = -1;
 
 	trace2_cmd_mode("write");
 
@@ -23,6 +23,7 @@
 #include "replace-object.h"
 #include "resolve-undo.h"
 #include "run-command.h"
+#include "thread-utils.h"
 #include "sparse-index.h"
 #include "worktree.h"
 #include "pack-revindex.h"
@@ -40,6 +41,7 @@ static int show_unreachable;
 static int include_reflogs = 1;
 static int check_full = 1;
 static int connectivity_only;
+static int nr_threads;
 static int check_strict;
 static int keep_cache_objects;
 static struct fsck_options fsck_walk_options = FSCK_OPTIONS_DEFAULT;
@@ -903,7 +905,7 @@ static char const * const fsck_usage[] = {
 	N_("git fsck [--tags] [--root] [--unreachable] [--cache] [--no-reflogs]\n"
 	   "         [--[no-]full] [--strict] [--verbose] [--lost-found]\n"
 	   "         [--[no-]dangling] [--[no-]progress] [--connectivity-only]\n"
-	   "         [--[no-]name-objects] [<object>...]"),
+	   "         [--[no-]name-objects] [--threads=<n>] [<object>...]"),
 	NULL
 };
 
@@ -922,6 +924,7 @@ static struct option fsck_opts[] = {
 				N_("write dangling objects in .git/lost-found")),
 	OPT_BOOL(0, "progress", &show_progress, N_("show progress")),
 	OPT_BOOL(0, "name-objects", &name_objects, N_("show verbose names for reachable objects")),
+	OPT_INTEGER(0, "threads", &nr_threads, N_("use <n> threads to check packed objects")),
 	OPT_END(),
 };
 
@@ -961,9 +964,22 @@ int cmd_fsck(int argc,
 	if (name_objects)
 		fsck_enable_object_names(&fsck_walk_options);
 
+	if (nr_threads < 0)
+		die(_("invalid number of threads specified (%d)"), nr_threads);
+	if (!HAVE_THREADS && nr_threads > 1) {
+		warning(_("no threads support, ignoring --threads"));
+		nr_threads = 1;
+	}
+	if (!nr_threads)
+		nr_threads = online_cpus();
+
 	git_config(git_fsck_config, &fsck_obj_options);
 	prepare_repo_settings(the_repository);
 
+	/* we are going to create an object for (nearly) everything we have */
+	reserve_object_hash(the_repository,
+			    repo_approximate_object_count(the_repository));
+
 	if (connectivity_only) {
 		for_each_loose_object(mark_loose_for_connectivity, NULL, 0);
 		for_each_packed_object(mark_packed_for_connectivity, NULL, 0);
@@ -992,7 +1008,7 @@ int cmd_fsck(int argc,
 				/* verify gives error messages itself */
 				if (verify_pack(the_repository,
 						p, fsck_obj_buffer,
-						progress, count))
+						progress, count, nr_threads))
 					errors_found |= ERROR_PACK;
 				count += p->num_objects;
 			}
@@ -23,6 +23,7 @@
 #include "replace-object.h"
 #include "promisor-remote.h"
 #include "setup.h"
+#include "trace2.h"
 
 static const char index_pack_usage[] =
 "git index-pack [-v] [-o <index-file>] [--keep | --keep=<msg>] [--[no-]rev-index] [--verify] [--strict[=<msg-id>=<severity>...]] [--fsck-objects[=<msg-id>=<severity>...]] (<pack-file> | --stdin [--fix-thin] [<pack-file>])";
@@ -170,6 +171,25 @@ static pthread_mutex_t deepest_delta_mutex;
 
 static pthread_key_t key;
 
+/*
+ * While the first pass reads the pack, the objects it inflates in full
+ * are queued for these threads to hash and check.
+ */
+struct hash_job {
+	struct object_entry *obj;
+	void *data;
+};
+
+static struct hash_job *hash_jobs;
+static unsigned int hash_jobs_alloc, hash_jobs_first, hash_jobs_nr;
+static size_t hash_jobs_size;
+static int hash_jobs_finished;
+static pthread_t *hash_threads;
+static int nr_hash_threads;
+static pthread_mutex_t hash_mutex;
+static pthread_cond_t hash_work_cond;
+static pthread_cond_t hash_room_cond;
+
 static inline void lock_mutex(pthread_mutex_t *mutex)
 {
 	if (threads_active)
@@ -461,17 +481,20 @@ static void *unpack_entry_data(off_t offset, unsigned long size,
 	char hdr[32];
 	int hdrlen;
 
-	if (!is_delta_type(type)) {
-		hdrlen = format_object_header(hdr, sizeof(hdr), type, size);
-		the_hash_algo->init_fn(&c);
-		the_hash_algo->update_fn(&c, hdr, hdrlen);
-	} else
-		oid = NULL;
 	if (type == OBJ_BLOB && size > big_file_threshold)
 		buf = fixed_buf;
 	else
 		buf = xmallocz(size);
 
+	/* the hashing threads take care of objects we have in full */
+	if (is_delta_type(type) || (nr_hash_threads && buf != fixed_buf))
+		oid = NULL;
+	if (oid) {
+		hdrlen = format_object_header(hdr, sizeof(hdr), type, size);
+		the_hash_algo->init_fn(&c);
+		the_hash_algo->update_fn(&c, hdr, hdrlen);
+	}
+
 	memset(&stream, 0, sizeof(stream));
 	git_inflate_init(&stream);
 	stream.next_out = buf;
@@ -1154,11 +1177,111 @@ static void *threaded_second_pass(void *data)
 	return NULL;
 }
 
+static void *hash_thread(void *data UNUSED)
+{
+	for (;;) {
+		struct hash_job job;
+
+		pthread_mutex_lock(&hash_mutex);
+		while (!hash_jobs_nr && !hash_jobs_finished)
+			pthread_cond_wait(&hash_work_cond, &hash_mutex);
+		if (!hash_jobs_nr) {
+			pthread_mutex_unlock(&hash_mutex);
+			break;
+		}
+		job = hash_jobs[hash_jobs_first];
+		hash_jobs_first = (hash_jobs_first + 1) % hash_jobs_alloc;
+		hash_jobs_nr--;
+		hash_jobs_size -= job.obj->size;
+		pthread_cond_signal(&hash_room_cond);
+		pthread_mutex_unlock(&hash_mutex);
+
+		hash_object_file(the_hash_algo, job.data, job.obj->size,
+				 job.obj->type, &job.obj->idx.oid);
+		sha1_object(job.data, NULL, job.obj->size, job.obj->type,
+			    &job.obj->idx.oid);
+		free(job.data);
+	}
+	return NULL;
+}
+
+static void start_hash_threads(void)
+{
+	int i;
+
+	init_thread();
+	pthread_mutex_init(&hash_mutex, NULL);
+	pthread_cond_init(&hash_work_cond, NULL);
+	pthread_cond_init(&hash_room_cond, NULL);
+	hash_jobs_alloc = 64 * nr_threads;
+	ALLOC_ARRAY(hash_jobs, hash_jobs_alloc);
+	hash_jobs_first = hash_jobs_nr = 0;
+	hash_jobs_size = 0;
+	hash_jobs_finished = 0;
+
+	ALLOC_ARRAY(hash_threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		int ret = pthread_create(&hash_threads[i], NULL,
+					 hash_thread, NULL);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+		nr_hash_threads++;
+	}
+
+	trace2_data_intmax("index-pack", the_repository,
+			   "hash-objects/threads", nr_hash_threads);
+}
+
+/*
+ * Hand "data", the inflated contents of "obj", to the hashing threads,
+ * which free it when they are done. To bound the memory we use, wait
+ * while they already have more than the delta base cache limit of data
+ * to chew on, unless the queue is empty.
+ */
+static void queue_hash_job(struct object_entry *obj, void *data)
+{
+	pthread_mutex_lock(&hash_mutex);
+	while (hash_jobs_nr == hash_jobs_alloc ||
+	       (hash_jobs_nr &&
+		hash_jobs_size + obj->size > delta_base_cache_limit))
+		pthread_cond_wait(&hash_room_cond, &hash_mutex);
+	hash_jobs[(hash_jobs_first + hash_jobs_nr) % hash_jobs_alloc].obj = obj;
+	hash_jobs[(hash_jobs_first + hash_jobs_nr) % hash_jobs_alloc].data = data;
+	hash_jobs_nr++;
+	hash_jobs_size += obj->size;
+	pthread_cond_signal(&hash_work_cond);
+	pthread_mutex_unlock(&hash_mutex);
+}
+
+static void finish_hash_threads(void)
+{
+	int i;
+
+	pthread_mutex_lock(&hash_mutex);
+	hash_jobs_finished = 1;
+	pthread_cond_broadcast(&hash_work_cond);
+	pthread_mutex_unlock(&hash_mutex);
+
+	for (i = 0; i < nr_hash_threads; i++)
+		pthread_join(hash_threads[i], NULL);
+	nr_hash_threads = 0;
+	FREE_AND_NULL(hash_threads);
+	FREE_AND_NULL(hash_jobs);
+	pthread_cond_destroy(&hash_room_cond);
+	pthread_cond_destroy(&hash_work_cond);
+	pthread_mutex_destroy(&hash_mutex);
+	cleanup_thread();
+}
+
 /*
  * First pass:
  * - find locations of all objects;
  * - calculate SHA1 of all non-delta objects;
  * - remember base (SHA1 or offset) for all deltas.
+ *
+ * Inflating must be done in order, as it is what tells us where the next
+ * object starts, but hashing and checking the objects we inflated can be
+ * left to other threads while we read on.
  */
 static void parse_pack_objects(unsigned char *hash)
 {
@@ -1173,6 +1296,8 @@ static void parse_pack_objects(unsigned char *hash)
 				progress_title ? progress_title :
 				from_stdin ? _("Receiving objects") : _("Indexing objects"),
 				nr_objects);
+	if (nr_threads > 1 || getenv("GIT_FORCE_THREADS"))
+		start_hash_threads();
 	for (i = 0; i < nr_objects; i++) {
 		struct object_entry *obj = &objects[i];
 		void *data = unpack_raw_entry(obj, &ofs_delta->offset,
@@ -1192,13 +1317,19 @@ static void parse_pack_objects(unsigned char *hash)
 			/* large blobs, check later */
 			obj->real_type = OBJ_BAD;
 			nr_delays++;
-		} else
+		} else if (nr_hash_threads) {
+			queue_hash_job(obj, data);
+			data = NULL;
+		} else {
 			sha1_object(data, NULL, obj->size, obj->type,
 				    &obj->idx.oid);
+		}
 		free(data);
 		display_progress(progress, i+1);
 	}
 	objects[i].idx.offset = consumed_bytes;
+	if (nr_hash_threads)
+		finish_hash_threads();
 	stop_progress(&progress);
 
 	/* Check pack integrity */
@@ -290,22 +290,64 @@ static void index_commit_for_bitmap(struct commit *commit)
 	indexed_commits[indexed_commits_nr++] = commit;
 }
 
-static void *get_delta(struct object_entry *entry)
+/*
+ * check_object() and the writer of the pack may run alongside other
+ * threads (see get_object_details() and write_pack_file()). The pack
+ * windows are shared, so taking and releasing them must be serialized,
+ * but the bytes of a window we hold on to can be examined without the
+ * lock.
+ */
+static unsigned char *use_pack_locked(struct packed_git *p,
+				      struct pack_window **w_curs,
+				      off_t offset, unsigned long *avail)
+{
+	unsigned char *buf;
+
+	packing_data_lock(&to_pack);
+	buf = use_pack(p, w_curs, offset, avail);
+	packing_data_unlock(&to_pack);
+	return buf;
+}
+
+static void unuse_pack_locked(struct pack_window **w_curs)
+{
+	packing_data_lock(&to_pack);
+	unuse_pack(w_curs);
+	packing_data_unlock(&to_pack);
+}
+
+static void *read_object_locked(const struct object_id *oid,
+				enum object_type *type, unsigned long *size)
+{
+	void *buf;
+
+	packing_data_lock(&to_pack);
+	buf = repo_read_object_file(the_repository, oid, type, size);
+	packing_data_unlock(&to_pack);
+	return buf;
+}
+
+static void close_istream_locked(struct git_istream *st)
+{
+	packing_data_lock(&to_pack);
+	close_istream(st);
+	packing_data_unlock(&to_pack);
+}
+
+static void *get_delta(const struct object_id *oid,
+		       const struct object_id *base_oid,
+		       unsigned long expect_size)
 {
 	unsigned long size, base_size, delta_size;
 	void *buf, *base_buf, *delta_buf;
 	enum object_type type;
 
-	buf = repo_read_object_file(the_repository, &entry->idx.oid, &type,
-				    &size);
+	buf = read_object_locked(oid, &type, &size);
 	if (!buf)
-		die(_("unable to read %s"), oid_to_hex(&entry->idx.oid));
-	base_buf = repo_read_object_file(the_repository,
-					 &DELTA(entry)->idx.oid, &type,
-					 &base_size);
+		die(_("unable to read %s"), oid_to_hex(oid));
+	base_buf = read_object_locked(base_oid, &type, &base_size);
 	if (!base_buf)
-		die("unable to read %s",
-		    oid_to_hex(&DELTA(entry)->idx.oid));
+		die("unable to read %s", oid_to_hex(base_oid));
 	delta_buf = diff_delta(base_buf, base_size,
 			       buf, size, &delta_size, 0);
 	/*
@@ -313,7 +355,7 @@ static void *get_delta(struct object_entry *entry)
 	 * memory reasons. Something is very wrong if this time we
 	 * recompute and create a different delta.
 	 */
-	if (!delta_buf || delta_size != DELTA_SIZE(entry))
+	if (!delta_buf || delta_size != expect_size)
 		BUG("delta size changed");
 	free(buf);
 	free(base_buf);
@@ -358,7 +400,9 @@ static unsigned long write_large_blob_data(struct git_istream *st, struct hashfi
 	for (;;) {
 		ssize_t readlen;
 		int zret = Z_OK;
+		packing_data_lock(&to_pack);
 		readlen = read_istream(st, ibuf, sizeof(ibuf));
+		packing_data_unlock(&to_pack);
 		if (readlen == -1)
 			die(_("unable to read %s"), oid_to_hex(oid));
 
@@ -401,7 +445,7 @@ static int check_pack_inflate(struct packed_git *p,
 	memset(&stream, 0, sizeof(stream));
 	git_inflate_init(&stream);
 	do {
-		in = use_pack(p, w_curs, offset, &stream.avail_in);
+		in = use_pack_locked(p, w_curs, offset, &stream.avail_in);
 		stream.next_in = in;
 		stream.next_out = fakebuf;
 		stream.avail_out = sizeof(fakebuf);
@@ -424,7 +468,7 @@ static void copy_pack_data(struct hashfile *f,
 	unsigned long avail;
 
 	while (len) {
-		in = use_pack(p, w_curs, offset, &avail);
+		in = use_pack_locked(p, w_curs, offset, &avail);
 		if (avail > len)
 			avail = (unsigned long)len;
 		hashwrite(f, in, avail);
@@ -444,6 +488,311 @@ static inline int oe_size_greater_than(struct packing_data *pack,
 	return oe_get_size_slow(pack, lhs) > rhs;
 }
 
+/*
+ * Decide whether write_object() can copy the data of an object from
+ * the pack it is in, instead of compressing it afresh.
+ */
+static int can_reuse_object_data(struct object_entry *entry, int usable_delta)
+{
+	if (!reuse_object)
+		return 0;	/* explicit */
+	else if (!IN_PACK(entry))
+		return 0;	/* can't reuse what we don't have */
+	else if (oe_type(entry) == OBJ_REF_DELTA ||
+		 oe_type(entry) == OBJ_OFS_DELTA)
+				/* check_object() decided it for us ... */
+		return usable_delta;
+				/* ... but pack split may override that */
+	else if (oe_type(entry) != entry->in_pack_type)
+		return 0;	/* pack has delta which is unusable */
+	else if (DELTA(entry))
+		return 0;	/* we want to pack afresh */
+	else
+		return 1;	/* we have it in-pack undeltified,
+				 * and we do not need to deltify it.
+				 */
+}
+
+/*
+ * When writing a single pack, the objects that have to be compressed
+ * afresh are read, delta-encoded and deflated by worker threads a
+ * little ahead of the writer, which only has to copy the result out in
+ * write order. The upcoming objects are kept in a ring of slots, and
+ * the workers pause while the deflated data waiting to be written
+ * exceeds WRITE_AHEAD_MEMORY.
+ */
+#define WRITE_AHEAD_SLOTS 1024
+#define WRITE_AHEAD_MEMORY (64 * 1024 * 1024)
+
+enum write_ahead_state {
+	WRITE_AHEAD_NONE = 0,	/* left to the writer */
+	WRITE_AHEAD_QUEUED,
+	WRITE_AHEAD_WORKING,
+	WRITE_AHEAD_READY
+};
+
+struct write_ahead_slot {
+	enum write_ahead_state state;
+	struct object_entry *entry;
+
+	/* filled by the writer, read-only for the workers */
+	struct object_id oid;
+	struct object_id base_oid;
+	unsigned long delta_size;
+	void *delta_data;
+	unsigned is_delta:1;
+
+	/* filled by the worker */
+	enum object_type type;
+	void *buf;
+	unsigned long size, datalen;
+};
+
+static struct write_ahead {
+	struct write_ahead_slot *slots;
+	struct object_entry **write_order;
+	uint32_t nr;
+	uint32_t head; /* the position the writer is at */
+	uint32_t next; /* the next position a worker looks at */
+	unsigned long pending; /* deflated bytes in READY slots */
+	int stop;
+
+	pthread_t *threads;
+	int nr_threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond; /* a slot was queued or writer moved on */
+	pthread_cond_t done_cond; /* a slot became READY */
+} write_ahead;
+
+/* Must be called by the writer, with write_ahead.mutex held. */
+static void queue_write_ahead(uint32_t pos)
+{
+	struct write_ahead_slot *slot = &write_ahead.slots[pos % WRITE_AHEAD_SLOTS];
+	struct object_entry *entry = write_ahead.write_order[pos];
+	int usable_delta = !!DELTA(entry);
+
+	memset(slot, 0, sizeof(*slot));
+	slot->entry = entry;
+
+	if (entry->preferred_base || entry->idx.offset ||
+	    can_reuse_object_data(entry, usable_delta))
+		return;
+	if (usable_delta) {
+		/* a cached delta that is already deflated is ready to go */
+		if (entry->z_delta_size)
+			return;
+		slot->is_delta = 1;
+		oidcpy(&slot->base_oid, &DELTA(entry)->idx.oid);
+		slot->delta_size = DELTA_SIZE(entry);
+		slot->delta_data = entry->delta_data;
+		entry->delta_data = NULL;
+	} else if (oe_type(entry) == OBJ_BLOB &&
+		   oe_size_greater_than(&to_pack, entry, big_file_threshold)) {
+		return; /* streamed by write_large_blob_data() */
+	}
+	oidcpy(&slot->oid, &entry->idx.oid);
+	slot->state = WRITE_AHEAD_QUEUED;
+}
+
+static void prepare_write_ahead_slot(struct write_ahead_slot *slot)
+{
+	void *buf;
+
+	if (slot->is_delta) {
+		buf = slot->delta_data;
+		if (!buf)
+			buf = get_delta(&slot->oid, &slot->base_oid,
+					slot->delta_size);
+		slot->delta_data = NULL;
+		slot->size = slot->delta_size;
+	} else {
+		buf = read_object_locked(&slot->oid, &slot->type, &slot->size);
+		if (!buf)
+			return; /* let the writer report it */
+	}
+	slot->datalen = do_compress(&buf, slot->size);
+	slot->buf = buf;
+}
+
+static void *write_ahead_worker(void *data UNUSED)
+{
+	pthread_mutex_lock(&write_ahead.mutex);
+	for (;;) {
+		struct write_ahead_slot *slot;
+		uint32_t end = write_ahead.head + WRITE_AHEAD_SLOTS;
+
+		if (end > write_ahead.nr)
+			end = write_ahead.nr;
+		if (write_ahead.next < write_ahead.head)
+			write_ahead.next = write_ahead.head;
+		while (write_ahead.next < end &&
+		       write_ahead.slots[write_ahead.next % WRITE_AHEAD_SLOTS].state != WRITE_AHEAD_QUEUED)
+			write_ahead.next++;
+		if (write_ahead.stop)
+			break;
+		if (write_ahead.next == end ||
+		    write_ahead.pending >= WRITE_AHEAD_MEMORY) {
+			pthread_cond_wait(&write_ahead.work_cond, &write_ahead.mutex);
+			continue;
+		}
+
+		slot = &write_ahead.slots[write_ahead.next++ % WRITE_AHEAD_SLOTS];
+		slot->state = WRITE_AHEAD_WORKING;
+		pthread_mutex_unlock(&write_ahead.mutex);
+
+		prepare_write_ahead_slot(slot);
+
+		pthread_mutex_lock(&write_ahead.mutex);
+		slot->state = WRITE_AHEAD_READY;
+		write_ahead.pending += slot->datalen;
+		pthread_cond_broadcast(&write_ahead.done_cond);
+	}
+	pthread_mutex_unlock(&write_ahead.mutex);
+	return NULL;
+}
+
+static void clear_write_ahead_slot(struct write_ahead_slot *slot)
+{
+	while (slot->state == WRITE_AHEAD_WORKING)
+		pthread_cond_wait(&write_ahead.done_cond, &write_ahead.mutex);
+	if (slot->state == WRITE_AHEAD_READY)
+		write_ahead.pending -= slot->datalen;
+	free(slot->buf);
+	free(slot->delta_data);
+	memset(slot, 0, sizeof(*slot));
+}
+
+static int write_ahead_threads(void)
+{
+	if (!HAVE_THREADS || delta_search_threads <= 1 || pack_size_limit)
+		return 0;
+	return delta_search_threads;
+}
+
+static void start_write_ahead(struct object_entry **write_order, uint32_t start)
+{
+	int nr_threads = write_ahead_threads();
+	uint32_t pos;
+	int i, ret;
+
+	if (!nr_threads || start >= to_pack.nr_objects)
+		return;
+
+	CALLOC_ARRAY(write_ahead.slots, WRITE_AHEAD_SLOTS);
+	write_ahead.write_order = write_order;
+	write_ahead.nr = to_pack.nr_objects;
+	write_ahead.head = write_ahead.next = start;
+	write_ahead.pending = 0;
+	write_ahead.stop = 0;
+	pthread_mutex_init(&write_ahead.mutex, NULL);
+	pthread_cond_init(&write_ahead.work_cond, NULL);
+	pthread_cond_init(&write_ahead.done_cond, NULL);
+
+	for (pos = start; pos < write_ahead.nr && pos < start + WRITE_AHEAD_SLOTS; pos++)
+		queue_write_ahead(pos);
+
+	CALLOC_ARRAY(write_ahead.threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&write_ahead.threads[i], NULL,
+				     write_ahead_worker, NULL);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+	write_ahead.nr_threads = nr_threads;
+
+	trace2_data_intmax("pack-objects", the_repository,
+			   "write-ahead/threads", nr_threads);
+}
+
+/*
+ * The writer is done with the object at position "pos" (which it may
+ * have written earlier as the base of another one, or skipped); reuse
+ * its slot for the next object.
+ */
+static void advance_write_ahead(uint32_t pos)
+{
+	if (!write_ahead.nr_threads)
+		return;
+
+	pthread_mutex_lock(&write_ahead.mutex);
+	clear_write_ahead_slot(&write_ahead.slots[pos % WRITE_AHEAD_SLOTS]);
+	write_ahead.head = pos + 1;
+	if (pos + WRITE_AHEAD_SLOTS < write_ahead.nr)
+		queue_write_ahead(pos + WRITE_AHEAD_SLOTS);
+	pthread_cond_broadcast(&write_ahead.work_cond);
+	pthread_mutex_unlock(&write_ahead.mutex);
+}
+
+static void stop_write_ahead(void)
+{
+	int i;
+
+	if (!write_ahead.nr_threads)
+		return;
+
+	pthread_mutex_lock(&write_ahead.mutex);
+	write_ahead.stop = 1;
+	pthread_cond_broadcast(&write_ahead.work_cond);
+	pthread_mutex_unlock(&write_ahead.mutex);
+	for (i = 0; i < write_ahead.nr_threads; i++)
+		pthread_join(write_ahead.threads[i], NULL);
+
+	for (i = 0; i < WRITE_AHEAD_SLOTS; i++)
+		clear_write_ahead_slot(&write_ahead.slots[i]);
+	pthread_cond_destroy(&write_ahead.done_cond);
+	pthread_cond_destroy(&write_ahead.work_cond);
+	pthread_mutex_destroy(&write_ahead.mutex);
+	FREE_AND_NULL(write_ahead.threads);
+	FREE_AND_NULL(write_ahead.slots);
+	write_ahead.nr_threads = 0;
+}
+
+/*
+ * Hand the deflated data for "entry" over to write_no_reuse_object(),
+ * if a worker prepared it. Otherwise, give back the cached delta we may
+ * have taken from it and let the caller do the work.
+ */
+static int take_write_ahead(struct object_entry *entry, int usable_delta,
+			    void **buf, unsigned long *size,
+			    enum object_type *type, unsigned long *datalen)
+{
+	struct write_ahead_slot *slot;
+	int ret = 0;
+
+	if (!write_ahead.nr_threads)
+		return 0;
+
+	pthread_mutex_lock(&write_ahead.mutex);
+	slot = &write_ahead.slots[write_ahead.head % WRITE_AHEAD_SLOTS];
+	if (slot->entry != entry || slot->state == WRITE_AHEAD_NONE)
+		goto out;
+
+	if (slot->state == WRITE_AHEAD_QUEUED) {
+		/* no worker got to it yet; it is quicker to do it ourselves */
+		if (usable_delta) {
+			entry->delta_data = slot->delta_data;
+			slot->delta_data = NULL;
+		}
+		clear_write_ahead_slot(slot);
+		goto out;
+	}
+
+	while (slot->state == WRITE_AHEAD_WORKING)
+		pthread_cond_wait(&write_ahead.done_cond, &write_ahead.mutex);
+	if (slot->buf && slot->is_delta == !!usable_delta) {
+		*buf = slot->buf;
+		*size = slot->size;
+		*type = slot->type;
+		*datalen = slot->datalen;
+		slot->buf = NULL;
+		ret = 1;
+	}
+	clear_write_ahead_slot(slot);
+out:
+	pthread_mutex_unlock(&write_ahead.mutex);
+	return ret;
+}
+
 /* Return 0 if we will bust the pack-size limit */
 static unsigned long write_no_reuse_object(struct hashfile *f, struct object_entry *entry,
 					   unsigned long limit, int usable_delta)
@@ -456,17 +805,29 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 	void *buf;
 	struct git_istream *st = NULL;
 	const unsigned hashsz = the_hash_algo->rawsz;
+	int prepared = take_write_ahead(entry, usable_delta, &buf, &size,
+					&type, &datalen);
 
-	if (!usable_delta) {
+	if (prepared) {
+		if (usable_delta) {
+			type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
+				OBJ_OFS_DELTA : OBJ_REF_DELTA;
+		} else {
+			FREE_AND_NULL(entry->delta_data);
+			entry->z_delta_size = 0;
+		}
+	} else if (!usable_delta) {
 		if (oe_type(entry) == OBJ_BLOB &&
-		    oe_size_greater_than(&to_pack, entry, big_file_threshold) &&
-		    (st = open_istream(the_repository, &entry->idx.oid, &type,
-				       &size, NULL)) != NULL)
+		    oe_size_greater_than(&to_pack, entry, big_file_threshold)) {
+			packing_data_lock(&to_pack);
+			st = open_istream(the_repository, &entry->idx.oid,
+					  &type, &size, NULL);
+			packing_data_unlock(&to_pack);
+		}
+		if (st)
 			buf = NULL;
 		else {
-			buf = repo_read_object_file(the_repository,
-						    &entry->idx.oid, &type,
-						    &size);
+			buf = read_object_locked(&entry->idx.oid, &type, &size);
 			if (!buf)
 				die(_("unable to read %s"),
 				    oid_to_hex(&entry->idx.oid));
@@ -484,13 +845,16 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 		type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
 			OBJ_OFS_DELTA : OBJ_REF_DELTA;
 	} else {
-		buf = get_delta(entry);
+		buf = get_delta(&entry->idx.oid, &DELTA(entry)->idx.oid,
+				DELTA_SIZE(entry));
 		size = DELTA_SIZE(entry);
 		type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
 			OBJ_OFS_DELTA : OBJ_REF_DELTA;
 	}
 
-	if (st)	/* large blob case, just assume we don't compress well */
+	if (prepared)
+		; /* already deflated */
+	else if (st)	/* large blob case, just assume we don't compress well */
 		datalen = size;
 	else if (entry->z_delta_size)
 		datalen = entry->z_delta_size;
@@ -517,7 +881,7 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 			dheader[--pos] = 128 | (--ofs & 127);
 		if (limit && hdrlen + sizeof(dheader) - pos + datalen + hashsz >= limit) {
 			if (st)
-				close_istream(st);
+				close_istream_locked(st);
 			free(buf);
 			return 0;
 		}
@@ -531,7 +895,7 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 		 */
 		if (limit && hdrlen + hashsz + datalen + hashsz >= limit) {
 			if (st)
-				close_istream(st);
+				close_istream_locked(st);
 			free(buf);
 			return 0;
 		}
@@ -541,7 +905,7 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 	} else {
 		if (limit && hdrlen + datalen + hashsz >= limit) {
 			if (st)
-				close_istream(st);
+				close_istream_locked(st);
 			free(buf);
 			return 0;
 		}
@@ -549,7 +913,7 @@ static unsigned long write_no_reuse_object(struct hashfile *f, struct object_ent
 	}
 	if (st) {
 		datalen = write_large_blob_data(st, f, &entry->idx.oid);
-		close_istream(st);
+		close_istream_locked(st);
 	} else {
 		hashwrite(f, buf, datalen);
 		free(buf);
@@ -573,6 +937,7 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 	unsigned hdrlen;
 	const unsigned hashsz = the_hash_algo->rawsz;
 	unsigned long entry_size = SIZE(entry);
+	int crc_error;
 
 	if (DELTA(entry))
 		type = (allow_ofs_delta && DELTA(entry)->idx.offset) ?
@@ -581,18 +946,21 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 					      type, entry_size);
 
 	offset = entry->in_pack_offset;
+	packing_data_lock(&to_pack);
 	if (offset_to_pack_pos(p, offset, &pos) < 0)
 		die(_("write_reuse_object: could not locate %s, expected at "
 		      "offset %"PRIuMAX" in pack %s"),
 		    oid_to_hex(&entry->idx.oid), (uintmax_t)offset,
 		    p->pack_name);
 	datalen = pack_pos_to_offset(p, pos + 1) - offset;
-	if (!pack_to_stdout && p->index_version > 1 &&
-	    check_pack_crc(p, &w_curs, offset, datalen,
-			   pack_pos_to_index(p, pos))) {
+	crc_error = !pack_to_stdout && p->index_version > 1 &&
+		check_pack_crc(p, &w_curs, offset, datalen,
+			       pack_pos_to_index(p, pos));
+	packing_data_unlock(&to_pack);
+	if (crc_error) {
 		error(_("bad packed object CRC for %s"),
 		      oid_to_hex(&entry->idx.oid));
-		unuse_pack(&w_curs);
+		unuse_pack_locked(&w_curs);
 		return write_no_reuse_object(f, entry, limit, usable_delta);
 	}
 
@@ -603,7 +971,7 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 	    check_pack_inflate(p, &w_curs, offset, datalen, entry_size)) {
 		error(_("corrupt packed object for %s"),
 		      oid_to_hex(&entry->idx.oid));
-		unuse_pack(&w_curs);
+		unuse_pack_locked(&w_curs);
 		return write_no_reuse_object(f, entry, limit, usable_delta);
 	}
 
@@ -614,7 +982,7 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		while (ofs >>= 7)
 			dheader[--pos] = 128 | (--ofs & 127);
 		if (limit && hdrlen + sizeof(dheader) - pos + datalen + hashsz >= limit) {
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return 0;
 		}
 		hashwrite(f, header, hdrlen);
@@ -623,7 +991,7 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		reused_delta++;
 	} else if (type == OBJ_REF_DELTA) {
 		if (limit && hdrlen + hashsz + datalen + hashsz >= limit) {
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return 0;
 		}
 		hashwrite(f, header, hdrlen);
@@ -632,13 +1000,13 @@ static off_t write_reuse_object(struct hashfile *f, struct object_entry *entry,
 		reused_delta++;
 	} else {
 		if (limit && hdrlen + datalen + hashsz >= limit) {
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return 0;
 		}
 		hashwrite(f, header, hdrlen);
 	}
 	copy_pack_data(f, p, &w_curs, offset, datalen);
-	unuse_pack(&w_curs);
+	unuse_pack_locked(&w_curs);
 	reused++;
 	return hdrlen + datalen;
 }
@@ -678,23 +1046,7 @@ static off_t write_object(struct hashfile *f,
 	else
 		usable_delta = 0;	/* base could end up in another pack */
 
-	if (!reuse_object)
-		to_reuse = 0;	/* explicit */
-	else if (!IN_PACK(entry))
-		to_reuse = 0;	/* can't reuse what we don't have */
-	else if (oe_type(entry) == OBJ_REF_DELTA ||
-		 oe_type(entry) == OBJ_OFS_DELTA)
-				/* check_object() decided it for us ... */
-		to_reuse = usable_delta;
-				/* ... but pack split may override that */
-	else if (oe_type(entry) != entry->in_pack_type)
-		to_reuse = 0;	/* pack has delta which is unusable */
-	else if (DELTA(entry))
-		to_reuse = 0;	/* we want to pack afresh */
-	else
-		to_reuse = 1;	/* we have it in-pack undeltified,
-				 * and we do not need to deltify it.
-				 */
+	to_reuse = can_reuse_object_data(entry, usable_delta);
 
 	if (!to_reuse)
 		len = write_no_reuse_object(f, entry, limit, usable_delta);
@@ -1280,6 +1632,12 @@ static void write_pack_file(void)
 	ALLOC_ARRAY(written_list, to_pack.nr_objects);
 	write_order = compute_write_order();
 
+	/*
+	 * Reused objects are mostly copied out of their packs in the order
+	 * they appear there.
+	 */
+	set_pack_access_pattern(the_repository, PACK_ACCESS_SEQUENTIAL);
+
 	do {
 		unsigned char hash[GIT_MAX_RAWSZ];
 		char *pack_tmp_name = NULL;
@@ -1303,12 +1661,15 @@ static void write_pack_file(void)
 		}
 
 		nr_written = 0;
+		start_write_ahead(write_order, i);
 		for (; i < to_pack.nr_objects; i++) {
 			struct object_entry *e = write_order[i];
 			if (write_one(f, e, &offset) == WRITE_ONE_BREAK)
 				break;
+			advance_write_ahead(i);
 			display_progress(progress_state, written);
 		}
+		stop_write_ahead();
 
 		if (pack_to_stdout) {
 			/*
@@ -1370,7 +1731,8 @@ static void write_pack_file(void)
 
 			if (write_bitmap_index) {
 				bitmap_writer_init(&bitmap_writer,
-						   the_repository, &to_pack);
+						   the_repository, &to_pack,
+						   NULL);
 				bitmap_writer_set_checksum(&bitmap_writer, hash);
 				bitmap_writer_build_type_index(&bitmap_writer,
 							       written_list);
@@ -1987,6 +2349,16 @@ static void cleanup_preferred_base(void)
 	done_pbase_paths_num = done_pbase_paths_alloc = 0;
 }
 
+static int bitmap_has_oid_in_uninteresting_locked(const struct object_id *oid)
+{
+	int ret;
+
+	packing_data_lock(&to_pack);
+	ret = bitmap_has_oid_in_uninteresting(bitmap_git, oid);
+	packing_data_unlock(&to_pack);
+	return ret;
+}
+
 /*
  * Return 1 iff the object specified by "delta" can be sent
  * literally as a delta against the base in "base_sha1". If
@@ -2021,7 +2393,7 @@ static int can_reuse_delta(const struct object_id *base_oid,
 	 * even if it was buried too deep in history to make it into the
 	 * packing list.
 	 */
-	if (thin && bitmap_has_oid_in_uninteresting(bitmap_git, base_oid)) {
+	if (thin && bitmap_has_oid_in_uninteresting_locked(base_oid)) {
 		if (use_delta_islands) {
 			if (!in_same_island(&delta->idx.oid, base_oid))
 				return 0;
@@ -2071,7 +2443,7 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 		enum object_type type;
 		unsigned long in_pack_size;
 
-		buf = use_pack(p, &w_curs, entry->in_pack_offset, &avail);
+		buf = use_pack_locked(p, &w_curs, entry->in_pack_offset, &avail);
 
 		/*
 		 * We want in_pack_type even if we do not reuse delta
@@ -2100,22 +2472,22 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			entry->in_pack_header_size = used;
 			if (oe_type(entry) < OBJ_COMMIT || oe_type(entry) > OBJ_BLOB)
 				goto give_up;
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return;
 		case OBJ_REF_DELTA:
 			if (reuse_delta && !entry->preferred_base) {
 				oidread(&base_ref,
-					use_pack(p, &w_curs,
-						 entry->in_pack_offset + used,
-						 NULL),
+					use_pack_locked(p, &w_curs,
+							entry->in_pack_offset + used,
+							NULL),
 					the_repository->hash_algo);
 				have_base = 1;
 			}
 			entry->in_pack_header_size = used + the_hash_algo->rawsz;
 			break;
 		case OBJ_OFS_DELTA:
-			buf = use_pack(p, &w_curs,
-				       entry->in_pack_offset + used, NULL);
+			buf = use_pack_locked(p, &w_curs,
+					      entry->in_pack_offset + used, NULL);
 			used_0 = 0;
 			c = buf[used_0++];
 			ofs = c & 127;
@@ -2137,11 +2509,16 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			}
 			if (reuse_delta && !entry->preferred_base) {
 				uint32_t pos;
-				if (offset_to_pack_pos(p, ofs, &pos) < 0)
-					goto give_up;
-				if (!nth_packed_object_id(&base_ref, p,
-							  pack_pos_to_index(p, pos)))
+				int ret;
+
+				packing_data_lock(&to_pack);
+				ret = offset_to_pack_pos(p, ofs, &pos);
+				if (!ret && !nth_packed_object_id(&base_ref, p,
+								  pack_pos_to_index(p, pos)))
 					have_base = 1;
+				packing_data_unlock(&to_pack);
+				if (ret < 0)
+					goto give_up;
 			}
 			entry->in_pack_header_size = used + used_0;
 			break;
@@ -2153,15 +2530,20 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			SET_SIZE(entry, in_pack_size); /* delta size */
 			SET_DELTA_SIZE(entry, in_pack_size);
 
+			/*
+			 * The base learns about us in link_reused_deltas(),
+			 * so that its list of children does not depend on
+			 * which thread got here first.
+			 */
 			if (base_entry) {
 				SET_DELTA(entry, base_entry);
-				entry->delta_sibling_idx = base_entry->delta_child_idx;
-				SET_DELTA_CHILD(base_entry, entry);
 			} else {
+				packing_data_lock(&to_pack);
 				SET_DELTA_EXT(entry, &base_ref);
+				packing_data_unlock(&to_pack);
 			}
 
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return;
 		}
 
@@ -2174,11 +2556,13 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			 * object size from the delta header.
 			 */
 			delta_pos = entry->in_pack_offset + entry->in_pack_header_size;
+			packing_data_lock(&to_pack);
 			canonical_size = get_size_from_delta(p, &w_curs, delta_pos);
+			packing_data_unlock(&to_pack);
 			if (canonical_size == 0)
 				goto give_up;
 			SET_SIZE(entry, canonical_size);
-			unuse_pack(&w_curs);
+			unuse_pack_locked(&w_curs);
 			return;
 		}
 
@@ -2188,9 +2572,10 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 		 * at this point...
 		 */
 		give_up:
-		unuse_pack(&w_curs);
+		unuse_pack_locked(&w_curs);
 	}
 
+	packing_data_lock(&to_pack);
 	if (oid_object_info_extended(the_repository, &entry->idx.oid, &oi,
 				     OBJECT_INFO_SKIP_FETCH_OBJECT | OBJECT_INFO_LOOKUP_REPLACE) < 0) {
 		if (repo_has_promisor_remote(the_repository)) {
@@ -2202,6 +2587,7 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			type = -1;
 		}
 	}
+	packing_data_unlock(&to_pack);
 	oe_set_type(entry, type);
 	if (entry->type_valid) {
 		SET_SIZE(entry, canonical_size);
@@ -2406,10 +2792,125 @@ static void break_delta_chains(struct object_entry *entry)
 	}
 }
 
+/*
+ * Number of entries a thread takes from the offset-sorted list at a
+ * time in get_object_details(); they are next to each other in the
+ * pack, so each thread still reads it mostly sequentially.
+ */
+#define CHECK_OBJECT_CHUNK 256
+
+struct check_object_params {
+	struct object_entry **list;
+	uint32_t nr;
+	uint32_t next; /* protected by packing_data_lock() */
+};
+
+static void check_object_range(struct object_entry **list,
+			       uint32_t start, uint32_t end)
+{
+	uint32_t i;
+
+	for (i = start; i < end; i++) {
+		struct object_entry *entry = list[i];
+		check_object(entry, i);
+		if (entry->type_valid &&
+		    oe_size_greater_than(&to_pack, entry, big_file_threshold))
+			entry->no_try_delta = 1;
+	}
+}
+
+static void *threaded_check_objects(void *arg)
+{
+	struct check_object_params *params = arg;
+
+	for (;;) {
+		uint32_t start, end;
+
+		packing_data_lock(&to_pack);
+		start = params->next;
+		end = start + CHECK_OBJECT_CHUNK;
+		if (end > params->nr)
+			end = params->nr;
+		params->next = end;
+		display_progress(progress_state, start);
+		packing_data_unlock(&to_pack);
+
+		if (start == end)
+			break;
+		check_object_range(params->list, start, end);
+	}
+	return NULL;
+}
+
+static int check_object_threads(void)
+{
+	int nr_threads = delta_search_threads;
+	uint32_t nr_chunks = DIV_ROUND_UP(to_pack.nr_objects, CHECK_OBJECT_CHUNK);
+
+	/*
+	 * Fetching missing objects from a promisor remote adds to the
+	 * object database behind our back; keep that single-threaded.
+	 */
+	if (!HAVE_THREADS || repo_has_promisor_remote(the_repository))
+		return 1;
+	if (nr_threads > nr_chunks)
+		nr_threads = nr_chunks;
+	return nr_threads > 1 ? nr_threads : 1;
+}
+
+static void check_objects_threaded(struct object_entry **list, uint32_t nr,
+				   int nr_threads)
+{
+	struct check_object_params params = {
+		.list = list,
+		.nr = nr,
+	};
+	pthread_t *threads;
+	int i, ret;
+
+	CALLOC_ARRAY(threads, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_create(&threads[i], NULL,
+				     threaded_check_objects, &params);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	trace2_data_intmax("pack-objects", the_repository,
+			   "check-object/threads", nr_threads);
+}
+
+/*
+ * check_object() only records the base of a delta it decided to reuse;
+ * add the entries to the list of children of their bases here, in the
+ * same order we would have if all of them were checked one by one.
+ */
+static void link_reused_deltas(struct object_entry **list, uint32_t nr)
+{
+	uint32_t i;
+
+	for (i = 0; i < nr; i++) {
+		struct object_entry *entry = list[i];
+		struct object_entry *base;
+
+		if (entry->ext_base)
+			continue;
+		base = DELTA(entry);
+		if (!base)
+			continue;
+		entry->delta_sibling_idx = base->delta_child_idx;
+		SET_DELTA_CHILD(base, entry);
+	}
+}
+
 static void get_object_details(void)
 {
 	uint32_t i;
 	struct object_entry **sorted_by_offset;
+	int nr_threads = check_object_threads();
 
 	if (progress)
 		progress_state = start_progress(_("Counting objects"),
@@ -2420,16 +2921,20 @@ static void get_object_details(void)
 		sorted_by_offset[i] = to_pack.objects + i;
 	QSORT(sorted_by_offset, to_pack.nr_objects, pack_offset_sort);
 
-	for (i = 0; i < to_pack.nr_objects; i++) {
-		struct object_entry *entry = sorted_by_offset[i];
-		check_object(entry, i);
-		if (entry->type_valid &&
-		    oe_size_greater_than(&to_pack, entry, big_file_threshold))
-			entry->no_try_delta = 1;
-		display_progress(progress_state, i + 1);
+	if (nr_threads > 1) {
+		check_objects_threaded(sorted_by_offset, to_pack.nr_objects,
+				       nr_threads);
+		display_progress(progress_state, to_pack.nr_objects);
+	} else {
+		for (i = 0; i < to_pack.nr_objects; i++) {
+			check_object_range(sorted_by_offset, i, i + 1);
+			display_progress(progress_state, i + 1);
+		}
 	}
 	stop_progress(&progress_state);
 
+	link_reused_deltas(sorted_by_offset, to_pack.nr_objects);
+
 	/*
 	 * This must happen in a second pass, since we rely on the delta
 	 * information for the whole list being completed.
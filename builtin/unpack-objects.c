@@ -8,6 +8,7 @@
 #include "hex.h"
 #include "object-store-ll.h"
 #include "object.h"
+#include "oidmap.h"
 #include "delta.h"
 #include "pack.h"
 #include "blob.h"
@@ -153,44 +154,80 @@ static void *get_data(unsigned long size)
 	return buf;
 }
 
+struct obj_info {
+	off_t offset;
+	struct object_id oid;
+	struct object *obj;
+};
+
+/* Remember to update object flag allocation in object.h */
+#define FLAG_OPEN (1u<<20)
+#define FLAG_WRITTEN (1u<<21)
+
+static struct obj_info *obj_list;
+static unsigned nr_objects;
+
 struct delta_info {
-	struct object_id base_oid;
 	unsigned nr;
-	off_t base_offset;
 	unsigned long size;
 	void *delta;
 	struct delta_info *next;
 };
 
-static struct delta_info *delta_list;
+/*
+ * Deltas whose base is not available yet are queued on the base they
+ * are waiting for, so that writing out an object only needs to visit
+ * its own children instead of scanning every pending delta.  Like
+ * index-pack, REF_DELTAs are keyed by the name of their base, and
+ * OFS_DELTAs by the position of their base in obj_list.
+ */
+struct ref_delta_entry {
+	struct oidmap_entry ent;
+	struct delta_info *children;
+};
+
+static struct oidmap ref_deltas = OIDMAP_INIT;
+static struct delta_info **ofs_deltas;
+static unsigned nr_pending_deltas;
 
-static void add_delta_to_list(unsigned nr, const struct object_id *base_oid,
-			      off_t base_offset,
-			      void *delta, unsigned long size)
+static struct delta_info *new_delta_info(unsigned nr, void *delta,
+					 unsigned long size)
 {
 	struct delta_info *info = xmalloc(sizeof(*info));
 
-	oidcpy(&info->base_oid, base_oid);
-	info->base_offset = base_offset;
+	info->nr = nr;
 	info->size = size;
 	info->delta = delta;
-	info->nr = nr;
-	info->next = delta_list;
-	delta_list = info;
+	info->next = NULL;
+	nr_pending_deltas++;
+	return info;
 }
 
-struct obj_info {
-	off_t offset;
-	struct object_id oid;
-	struct object *obj;
-};
+static void add_ref_delta(unsigned nr, const struct object_id *base_oid,
+			  void *delta, unsigned long size)
+{
+	struct delta_info *info = new_delta_info(nr, delta, size);
+	struct ref_delta_entry *entry = oidmap_get(&ref_deltas, base_oid);
 
-/* Remember to update object flag allocation in object.h */
-#define FLAG_OPEN (1u<<20)
-#define FLAG_WRITTEN (1u<<21)
+	if (!entry) {
+		CALLOC_ARRAY(entry, 1);
+		oidcpy(&entry->ent.oid, base_oid);
+		oidmap_put(&ref_deltas, entry);
+	}
+	info->next = entry->children;
+	entry->children = info;
+}
 
-static struct obj_info *obj_list;
-static unsigned nr_objects;
+static void add_ofs_delta(unsigned nr, unsigned base_nr,
+			  void *delta, unsigned long size)
+{
+	struct delta_info *info = new_delta_info(nr, delta, size);
+
+	if (!ofs_deltas)
+		CALLOC_ARRAY(ofs_deltas, nr_objects);
+	info->next = ofs_deltas[base_nr];
+	ofs_deltas[base_nr] = info;
+}
 
 /*
  * Called only from check_object() after it verified this object
@@ -321,6 +358,20 @@ static void resolve_delta(unsigned nr, enum object_type type,
 	write_object(nr, type, result, result_size);
 }
 
+static void resolve_children(struct delta_info *info, enum object_type type,
+			     void *data, unsigned long size)
+{
+	while (info) {
+		struct delta_info *next = info->next;
+
+		nr_pending_deltas--;
+		resolve_delta(info->nr, type, data, size,
+			      info->delta, info->size);
+		free(info);
+		info = next;
+	}
+}
+
 /*
  * We now know the contents of an object (which is nr-th in the pack);
  * resolve all the deltified objects that are based on it.
@@ -328,20 +379,21 @@ static void resolve_delta(unsigned nr, enum object_type type,
 static void added_object(unsigned nr, enum object_type type,
 			 void *data, unsigned long size)
 {
-	struct delta_info **p = &delta_list;
-	struct delta_info *info;
-
-	while ((info = *p) != NULL) {
-		if (oideq(&info->base_oid, &obj_list[nr].oid) ||
-		    info->base_offset == obj_list[nr].offset) {
-			*p = info->next;
-			p = &delta_list;
-			resolve_delta(info->nr, type, data, size,
-				      info->delta, info->size);
-			free(info);
-			continue;
-		}
-		p = &info->next;
+	struct ref_delta_entry *entry;
+
+	if (!nr_pending_deltas)
+		return;
+
+	entry = oidmap_remove(&ref_deltas, &obj_list[nr].oid);
+	if (entry) {
+		resolve_children(entry->children, type, data, size);
+		free(entry);
+	}
+	if (ofs_deltas && ofs_deltas[nr]) {
+		struct delta_info *children = ofs_deltas[nr];
+
+		ofs_deltas[nr] = NULL;
+		resolve_children(children, type, data, size);
 	}
 }
 
@@ -453,11 +505,11 @@ static void unpack_delta_entry(enum object_type type, unsigned long delta_size,
 		else {
 			/* cannot resolve yet --- queue it */
 			oidclr(&obj_list[nr].oid, the_repository->hash_algo);
-			add_delta_to_list(nr, &base_oid, 0, delta_data, delta_size);
+			add_ref_delta(nr, &base_oid, delta_data, delta_size);
 			return;
 		}
 	} else {
-		unsigned base_found = 0;
+		unsigned base_found = 0, base_nr = nr;
 		unsigned char *pack, c;
 		off_t base_offset;
 		unsigned lo, mid, hi;
@@ -493,17 +545,26 @@ static void unpack_delta_entry(enum object_type type, unsigned long delta_size,
 			} else {
 				oidcpy(&base_oid, &obj_list[mid].oid);
 				base_found = !is_null_oid(&base_oid);
+				base_nr = mid;
 				break;
 			}
 		}
 		if (!base_found) {
+			oidclr(&obj_list[nr].oid, the_repository->hash_algo);
+			if (base_nr == nr) {
+				/*
+				 * No object starts at base_offset, so this
+				 * delta can never be resolved.
+				 */
+				nr_pending_deltas++;
+				free(delta_data);
+				return;
+			}
 			/*
 			 * The delta base object is itself a delta that
 			 * has not been resolved yet.
 			 */
-			oidclr(&obj_list[nr].oid, the_repository->hash_algo);
-			add_delta_to_list(nr, null_oid(), base_offset,
-					  delta_data, delta_size);
+			add_ofs_delta(nr, base_nr, delta_data, delta_size);
 			return;
 		}
 	}
@@ -598,8 +659,11 @@ static void unpack_all(void)
 	end_odb_transaction();
 	stop_progress(&progress);
 
-	if (delta_list)
+	if (nr_pending_deltas)
 		die("unresolved deltas left after unpacking");
+
+	FREE_AND_NULL(ofs_deltas);
+	oidmap_free(&ref_deltas, 1);
 }
 
 int cmd_unpack_objects(int argc,
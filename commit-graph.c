@@ -24,6 +24,7 @@
 #include "commit-slab.h"
 #include "shallow.h"
 #include "json-writer.h"
+#include "trace.h"
 #include "trace2.h"
 #include "tree.h"
 #include "chunk-format.h"
@@ -215,7 +216,7 @@ static struct commit_graph *alloc_commit_graph(void)
 	return g;
 }
 
-static int commit_graph_compatible(struct repository *r)
+int commit_graph_compatible(struct repository *r)
 {
 	if (!r->gitdir)
 		return 0;
@@ -1792,6 +1793,7 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 	struct progress *progress = NULL;
 	struct commit **sorted_commits;
 	int max_new_filters;
+	uint64_t deadline = 0;
 
 	init_bloom_filters();
 
@@ -1809,11 +1811,25 @@ static void compute_bloom_filters(struct write_commit_graph_context *ctx)
 
 	max_new_filters = ctx->opts && ctx->opts->max_new_filters >= 0 ?
 		ctx->opts->max_new_filters : ctx->commits.nr;
+	if (ctx->opts && ctx->opts->max_new_filter_time >= 0)
+		deadline = getnanotime() +
+			(uint64_t)ctx->opts->max_new_filter_time * 1000000;
 
 	for (i = 0; i < ctx->commits.nr; i++) {
 		enum bloom_filter_computed computed = 0;
 		struct commit *c = sorted_commits[i];
-		struct bloom_filter *filter = get_or_compute_bloom_filter(
+		struct bloom_filter *filter;
+
+		/*
+		 * Once the time budget is spent, stop computing new filters
+		 * but keep loading the ones we already have; commits left
+		 * without one can be filled in by a later write.
+		 */
+		if (deadline && ctx->count_bloom_filter_computed < max_new_filters &&
+		    getnanotime() >= deadline)
+			max_new_filters = ctx->count_bloom_filter_computed;
+
+		filter = get_or_compute_bloom_filter(
 			ctx->r,
 			c,
 			ctx->count_bloom_filter_computed < max_new_filters,
@@ -131,6 +131,14 @@ struct repo_settings;
 struct commit_graph *parse_commit_graph(struct repo_settings *s,
 					void *graph_map, size_t graph_size);
 
+/*
+ * Return 0 if the history of the repository is altered by replace refs,
+ * grafts or a shallow clone, so that data computed from the commits as
+ * they are stored (like the commit-graph, or reachability bitmaps) does
+ * not describe it, and 1 otherwise.
+ */
+int commit_graph_compatible(struct repository *r);
+
 /*
  * Return 1 if and only if the repository has a commit-graph
  * file and generation numbers are computed in that file.
@@ -165,6 +173,7 @@ struct commit_graph_opts {
 	timestamp_t expire_time;
 	enum commit_graph_split_flags split_flags;
 	int max_new_filters;
+	int max_new_filter_time;
 };
 
 /*
@@ -11,6 +11,8 @@
 #include "tag.h"
 #include "commit-reach.h"
 #include "ewah/ewok.h"
+#include "pack-bitmap.h"
+#include "trace2.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1		(1u<<16)
@@ -686,7 +688,8 @@ static int in_commit_list(const struct commit_list *want, struct commit *c)
 static enum contains_result contains_test(struct commit *candidate,
 					  const struct commit_list *want,
 					  struct contains_cache *cache,
-					  timestamp_t cutoff)
+					  timestamp_t cutoff,
+					  struct bitmap_index *bitmap_git)
 {
 	enum contains_result *cached = contains_cache_at(cache, candidate);
 
@@ -700,6 +703,18 @@ static enum contains_result contains_test(struct commit *candidate,
 		return CONTAINS_YES;
 	}
 
+	/* or does our bitmap know? */
+	if (bitmap_git) {
+		switch (bitmap_commit_reaches_any(bitmap_git, candidate, want)) {
+		case 1:
+			*cached = CONTAINS_YES;
+			return CONTAINS_YES;
+		case 0:
+			*cached = CONTAINS_NO;
+			return CONTAINS_NO;
+		}
+	}
+
 	/* Otherwise, we don't know; prepare to recurse */
 	parse_commit_or_die(candidate);
 
@@ -718,7 +733,8 @@ static void push_to_contains_stack(struct commit *candidate, struct contains_sta
 
 static enum contains_result contains_tag_algo(struct commit *candidate,
 					      const struct commit_list *want,
-					      struct contains_cache *cache)
+					      struct contains_cache *cache,
+					      struct bitmap_index *bitmap_git)
 {
 	struct contains_stack contains_stack = { 0, 0, NULL };
 	enum contains_result result;
@@ -734,7 +750,7 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 			cutoff = generation;
 	}
 
-	result = contains_test(candidate, want, cache, cutoff);
+	result = contains_test(candidate, want, cache, cutoff, bitmap_git);
 	if (result != CONTAINS_UNKNOWN)
 		return result;
 
@@ -752,7 +768,8 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 		 * If we just popped the stack, parents->item has been marked,
 		 * therefore contains_test will return a meaningful yes/no.
 		 */
-		else switch (contains_test(parents->item, want, cache, cutoff)) {
+		else switch (contains_test(parents->item, want, cache, cutoff,
+					   bitmap_git)) {
 		case CONTAINS_YES:
 			*contains_cache_at(cache, commit) = CONTAINS_YES;
 			contains_stack.nr--;
@@ -766,17 +783,33 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 		}
 	}
 	free(contains_stack.contains_stack);
-	return contains_test(candidate, want, cache, cutoff);
+	return contains_test(candidate, want, cache, cutoff, bitmap_git);
 }
 
 int commit_contains(struct ref_filter *filter, struct commit *commit,
 		    struct commit_list *list, struct contains_cache *cache)
 {
-	if (filter->with_commit_tag_algo)
-		return contains_tag_algo(commit, list, cache) == CONTAINS_YES;
+	struct bitmap_index *bitmap_git = filter->internal.bitmap_git;
+
+	/*
+	 * With bitmaps, the depth-first search of the tag algorithm stops
+	 * at the first commits with a bitmap, and remembers the answer
+	 * for the next ref, which is much faster than a merge-base
+	 * computation per ref.
+	 */
+	if (filter->with_commit_tag_algo || bitmap_git)
+		return contains_tag_algo(commit, list, cache,
+					 bitmap_git) == CONTAINS_YES;
 	return repo_is_descendant_of(the_repository, commit, list);
 }
 
+struct bitmap_index *prepare_reachability_bitmap(struct repository *r)
+{
+	if (!commit_graph_compatible(r))
+		return NULL;
+	return prepare_bitmap_git(r);
+}
+
 int can_all_from_reach_with_flag(struct object_array *from,
 				 unsigned int with_flag,
 				 unsigned int assign_flag,
@@ -1038,16 +1071,13 @@ static void free_bit_array(struct commit *c)
 	*bitmap = NULL;
 }
 
-void ahead_behind(struct repository *r,
-		  struct commit **commits, size_t commits_nr,
-		  struct ahead_behind_count *counts, size_t counts_nr)
+static void ahead_behind_walk(struct repository *r,
+			      struct commit **commits, size_t commits_nr,
+			      struct ahead_behind_count *counts, size_t counts_nr)
 {
 	struct prio_queue queue = { .compare = compare_commits_by_gen_then_commit_date };
 	size_t width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
 
-	if (!commits_nr || !counts_nr)
-		return;
-
 	for (size_t i = 0; i < counts_nr; i++) {
 		counts[i].ahead = 0;
 		counts[i].behind = 0;
@@ -1116,6 +1146,158 @@ void ahead_behind(struct repository *r,
 	clear_prio_queue(&queue);
 }
 
+static unsigned int count_and_not(struct bitmap *a, struct bitmap *b)
+{
+	struct bitmap *tmp = bitmap_dup(a);
+	size_t count;
+
+	bitmap_and_not(tmp, b);
+	count = bitmap_popcount(tmp);
+	bitmap_free(tmp);
+	return count;
+}
+
+/*
+ * Compute the counts which the reachability bitmaps can answer, as the
+ * number of commits in the bitmap of the tip and not in that of the
+ * base, and the other way around. Return the indices of the counts they
+ * cannot answer in "todo", which the caller must free.
+ */
+static size_t ahead_behind_bitmap(struct bitmap_index *bitmap_git,
+				  struct commit **commits, size_t commits_nr,
+				  struct ahead_behind_count *counts,
+				  size_t counts_nr, size_t **todo)
+{
+	struct bitmap **reachable;
+	size_t *last_use;
+	char *uncovered;
+	size_t todo_nr = 0, todo_alloc = 0;
+
+	CALLOC_ARRAY(reachable, commits_nr);
+	CALLOC_ARRAY(uncovered, commits_nr);
+	CALLOC_ARRAY(last_use, commits_nr);
+	*todo = NULL;
+
+	/*
+	 * There may be many tips, so do not keep their bitmaps around for
+	 * longer than needed.
+	 */
+	for (size_t i = 0; i < counts_nr; i++) {
+		last_use[counts[i].tip_index] = i;
+		last_use[counts[i].base_index] = i;
+	}
+
+	for (size_t i = 0; i < counts_nr; i++) {
+		size_t ends[] = { counts[i].tip_index, counts[i].base_index };
+		struct bitmap *tip, *base;
+
+		for (size_t j = 0; j < ARRAY_SIZE(ends); j++) {
+			size_t e = ends[j];
+
+			if (reachable[e] || uncovered[e])
+				continue;
+			reachable[e] = bitmap_reachable_commits(bitmap_git,
+								commits[e]);
+			if (!reachable[e])
+				uncovered[e] = 1;
+		}
+
+		tip = reachable[counts[i].tip_index];
+		base = reachable[counts[i].base_index];
+		if (tip && base) {
+			counts[i].ahead = count_and_not(tip, base);
+			counts[i].behind = count_and_not(base, tip);
+		} else {
+			ALLOC_GROW(*todo, todo_nr + 1, todo_alloc);
+			(*todo)[todo_nr++] = i;
+		}
+
+		for (size_t j = 0; j < ARRAY_SIZE(ends); j++) {
+			size_t e = ends[j];
+
+			if (last_use[e] == i) {
+				bitmap_free(reachable[e]);
+				reachable[e] = NULL;
+			}
+		}
+	}
+
+	free(last_use);
+	free(uncovered);
+	free(reachable);
+	return todo_nr;
+}
+
+void ahead_behind(struct repository *r,
+		  struct commit **commits, size_t commits_nr,
+		  struct ahead_behind_count *counts, size_t counts_nr)
+{
+	struct bitmap_index *bitmap_git;
+	struct ahead_behind_count *todo_counts;
+	struct commit **todo_commits;
+	size_t *todo, todo_nr, todo_commits_nr = 0;
+	size_t *commit_map;
+
+	if (!commits_nr || !counts_nr)
+		return;
+
+	bitmap_git = prepare_reachability_bitmap(r);
+	if (!bitmap_git) {
+		ahead_behind_walk(r, commits, commits_nr, counts, counts_nr);
+		return;
+	}
+
+	todo_nr = ahead_behind_bitmap(bitmap_git, commits, commits_nr,
+				      counts, counts_nr, &todo);
+	free_bitmap_index(bitmap_git);
+
+	trace2_data_intmax("ahead_behind", r, "bitmap_counts",
+			   counts_nr - todo_nr);
+	if (!todo_nr)
+		goto done;
+
+	/*
+	 * Walk for the counts that the bitmaps could not answer, starting
+	 * only from the commits which these involve.
+	 */
+	ALLOC_ARRAY(commit_map, commits_nr);
+	for (size_t i = 0; i < commits_nr; i++)
+		commit_map[i] = SIZE_MAX;
+	ALLOC_ARRAY(todo_commits, commits_nr);
+	ALLOC_ARRAY(todo_counts, todo_nr);
+
+	for (size_t i = 0; i < todo_nr; i++) {
+		struct ahead_behind_count *count = &counts[todo[i]];
+		size_t *tip = &commit_map[count->tip_index];
+		size_t *base = &commit_map[count->base_index];
+
+		if (*tip == SIZE_MAX) {
+			*tip = todo_commits_nr;
+			todo_commits[todo_commits_nr++] = commits[count->tip_index];
+		}
+		if (*base == SIZE_MAX) {
+			*base = todo_commits_nr;
+			todo_commits[todo_commits_nr++] = commits[count->base_index];
+		}
+
+		todo_counts[i].tip_index = *tip;
+		todo_counts[i].base_index = *base;
+	}
+
+	ahead_behind_walk(r, todo_commits, todo_commits_nr, todo_counts, todo_nr);
+
+	for (size_t i = 0; i < todo_nr; i++) {
+		counts[todo[i]].ahead = todo_counts[i].ahead;
+		counts[todo[i]].behind = todo_counts[i].behind;
+	}
+
+	free(todo_counts);
+	free(todo_commits);
+	free(commit_map);
+done:
+	free(todo);
+}
+
 struct commit_and_index {
 	struct commit *commit;
 	unsigned int index;
@@ -4,6 +4,7 @@
 #include "commit.h"
 #include "commit-slab.h"
 
+struct bitmap_index;
 struct commit_list;
 struct ref_filter;
 struct object_id;
@@ -71,6 +72,14 @@ define_commit_slab(contains_cache, enum contains_result);
 int commit_contains(struct ref_filter *filter, struct commit *commit,
 		    struct commit_list *list, struct contains_cache *cache);
 
+/*
+ * Open the reachability bitmaps of the repository for answering the
+ * queries above with. Return NULL if there are none, or if they cannot
+ * be used because replace refs, grafts or a shallow clone alter the
+ * history.
+ */
+struct bitmap_index *prepare_reachability_bitmap(struct repository *r);
+
 /*
  * Determine if every commit in 'from' can reach at least one commit
  * that is marked with 'with_flag'. As we traverse, use 'assign_flag'
@@ -125,6 +134,10 @@ struct ahead_behind_count {
 /*
  * Given an array of commits and an array of ahead_behind_count pairs,
  * compute the ahead/behind counts for each pair.
+ *
+ * The counts are computed from reachability bitmaps when the repository
+ * has them, and by walking the commit graph when it does not, or when
+ * the bitmaps do not cover the tip or base of a pair.
  */
 void ahead_behind(struct repository *r,
 		  struct commit **commits, size_t commits_nr,
@@ -53,6 +53,26 @@ int win32_pthread_join(pthread_t *thread, void **value_ptr)
 	}
 }
 
+struct once_fn {
+	void (*fn)(void);
+};
+
+static BOOL CALLBACK run_once_fn(PINIT_ONCE once UNUSED, PVOID param,
+				 PVOID *context UNUSED)
+{
+	((struct once_fn *)param)->fn();
+	return TRUE;
+}
+
+int pthread_once(pthread_once_t *once, void (*fn)(void))
+{
+	struct once_fn param = { fn };
+
+	if (!InitOnceExecuteOnce(once, run_once_fn, &param, NULL))
+		return err_win_to_posix(GetLastError());
+	return 0;
+}
+
 pthread_t pthread_self(void)
 {
 	pthread_t t = { NULL };
@@ -1515,6 +1515,16 @@ static int git_default_core_config(const char *var, const char *value,
 		return 0;
 	}
 
+	if (!strcmp(var, "core.packedgitmapwhole")) {
+		packed_git_map_whole = git_config_bool(var, value);
+		return 0;
+	}
+
+	if (!strcmp(var, "core.checksumthread")) {
+		checksum_thread = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (!strcmp(var, "core.deltabasecachelimit")) {
 		delta_base_cache_limit = git_config_ulong(var, value, ctx->kvi);
 		return 0;
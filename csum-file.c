@@ -11,9 +11,12 @@
 #define USE_THE_REPOSITORY_VARIABLE
 
 #include "git-compat-util.h"
+#include "environment.h"
 #include "progress.h"
 #include "csum-file.h"
 #include "hash.h"
+#include "parse.h"
+#include "thread-utils.h"
 
 static void verify_buffer_or_die(struct hashfile *f,
 				 const void *buf,
@@ -29,7 +32,7 @@ static void verify_buffer_or_die(struct hashfile *f,
 		die("sha1 file '%s' validation error", f->name);
 }
 
-static void flush(struct hashfile *f, const void *buf, unsigned int count)
+static void write_buffer(struct hashfile *f, const void *buf, unsigned int count)
 {
 	if (0 <= f->check_fd && count)
 		verify_buffer_or_die(f, buf, count);
@@ -39,15 +42,138 @@ static void flush(struct hashfile *f, const void *buf, unsigned int count)
 			die("sha1 file '%s' write error. Out of diskspace", f->name);
 		die_errno("sha1 file '%s' write error", f->name);
 	}
+}
+
+static void flush(struct hashfile *f, const void *buf, unsigned int count)
+{
+	write_buffer(f, buf, count);
+	f->total += count;
+	display_throughput(f->tp, f->total);
+}
+
+/*
+ * With core.checksumThread, the buffer of a hashfile is handed to a helper
+ * thread once it is full, and the caller goes on filling a second buffer
+ * while the first one is hashed and written out. The hashing context and
+ * the file descriptors belong to the helper thread until it is idle again,
+ * which hashfile_wait() makes sure of.
+ */
+struct hashfile_thread {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned char *buffer;
+	unsigned int len;
+	int done;
+};
+
+static void *hashfile_thread(void *data)
+{
+	struct hashfile *f = data;
+	struct hashfile_thread *t = f->thread;
+
+	pthread_mutex_lock(&t->mutex);
+	for (;;) {
+		while (!t->len && !t->done)
+			pthread_cond_wait(&t->cond, &t->mutex);
+		if (!t->len)
+			break;
+		pthread_mutex_unlock(&t->mutex);
+
+		if (!f->skip_hash)
+			the_hash_algo->unsafe_update_fn(&f->ctx, t->buffer, t->len);
+		write_buffer(f, t->buffer, t->len);
+
+		pthread_mutex_lock(&t->mutex);
+		t->len = 0;
+		pthread_cond_broadcast(&t->cond);
+	}
+	pthread_mutex_unlock(&t->mutex);
+	return NULL;
+}
+
+static void hashfile_start_thread(struct hashfile *f)
+{
+	struct hashfile_thread *t;
+	int ret;
+
+	CALLOC_ARRAY(t, 1);
+	pthread_mutex_init(&t->mutex, NULL);
+	pthread_cond_init(&t->cond, NULL);
+	t->buffer = xmalloc(f->buffer_len);
+	f->thread = t;
+
+	ret = pthread_create(&t->thread, NULL, hashfile_thread, f);
+	if (ret) {
+		/* we can do without it */
+		pthread_cond_destroy(&t->cond);
+		pthread_mutex_destroy(&t->mutex);
+		free(t->buffer);
+		FREE_AND_NULL(f->thread);
+	}
+}
+
+/* Wait until the helper thread is done with the buffer we gave it. */
+static void hashfile_wait(struct hashfile *f)
+{
+	struct hashfile_thread *t = f->thread;
+
+	pthread_mutex_lock(&t->mutex);
+	while (t->len)
+		pthread_cond_wait(&t->cond, &t->mutex);
+	pthread_mutex_unlock(&t->mutex);
+}
+
+/*
+ * Give the first "count" bytes of our buffer to the helper thread, and
+ * take the one it was done with in exchange.
+ */
+static void hashfile_hand_off(struct hashfile *f, unsigned int count)
+{
+	struct hashfile_thread *t = f->thread;
+	unsigned char *buffer;
+
+	hashfile_wait(f);
+	pthread_mutex_lock(&t->mutex);
+	buffer = t->buffer;
+	t->buffer = f->buffer;
+	t->len = count;
+	pthread_cond_broadcast(&t->cond);
+	pthread_mutex_unlock(&t->mutex);
+	f->buffer = buffer;
 
 	f->total += count;
 	display_throughput(f->tp, f->total);
 }
 
+static void hashfile_stop_thread(struct hashfile *f)
+{
+	struct hashfile_thread *t = f->thread;
+
+	pthread_mutex_lock(&t->mutex);
+	t->done = 1;
+	pthread_cond_broadcast(&t->cond);
+	pthread_mutex_unlock(&t->mutex);
+	pthread_join(t->thread, NULL);
+
+	pthread_cond_destroy(&t->cond);
+	pthread_mutex_destroy(&t->mutex);
+	free(t->buffer);
+	FREE_AND_NULL(f->thread);
+}
+
 void hashflush(struct hashfile *f)
 {
 	unsigned offset = f->offset;
 
+	if (f->thread) {
+		if (offset)
+			hashfile_hand_off(f, offset);
+		hashfile_wait(f);
+		f->offset = 0;
+		return;
+	}
+
 	if (offset) {
 		if (!f->skip_hash)
 			the_hash_algo->unsafe_update_fn(&f->ctx, f->buffer, offset);
@@ -58,6 +184,8 @@ void hashflush(struct hashfile *f)
 
 void free_hashfile(struct hashfile *f)
 {
+	if (f->thread)
+		hashfile_stop_thread(f);
 	free(f->buffer);
 	free(f->check_buffer);
 	free(f);
@@ -104,6 +232,8 @@ int finalize_hashfile(struct hashfile *f, unsigned char *result,
 
 void discard_hashfile(struct hashfile *f)
 {
+	if (f->thread)
+		hashfile_stop_thread(f);
 	if (0 <= f->check_fd)
 		close(f->check_fd);
 	if (0 <= f->fd)
@@ -120,7 +250,7 @@ void hashwrite(struct hashfile *f, const void *buf, unsigned int count)
 		if (f->do_crc)
 			f->crc32 = crc32(f->crc32, buf, nr);
 
-		if (nr == f->buffer_len) {
+		if (nr == f->buffer_len && !f->thread) {
 			/*
 			 * Flush a full batch worth of data directly
 			 * from the input, skipping the memcpy() to
@@ -138,8 +268,12 @@ void hashwrite(struct hashfile *f, const void *buf, unsigned int count)
 			memcpy(f->buffer + f->offset, buf, nr);
 			f->offset += nr;
 			left -= nr;
-			if (!left)
+			if (!left && f->thread) {
+				hashfile_hand_off(f, f->offset);
+				f->offset = 0;
+			} else if (!left) {
 				hashflush(f);
+			}
 		}
 
 		count -= nr;
@@ -180,6 +314,11 @@ static struct hashfile *hashfd_internal(int fd, const char *name,
 	f->buffer = xmalloc(buffer_len);
 	f->check_buffer = NULL;
 
+	f->thread = NULL;
+	if (HAVE_THREADS &&
+	    (checksum_thread || git_env_bool("GIT_TEST_CHECKSUM_THREAD", 0)))
+		hashfile_start_thread(f);
+
 	return f;
 }
 
@@ -215,6 +354,13 @@ int hashfile_truncate(struct hashfile *f, struct hashfile_checkpoint *checkpoint
 {
 	off_t offset = checkpoint->offset;
 
+	/*
+	 * Let the helper thread finish writing what we gave it since the
+	 * checkpoint, or it could land after the truncation.
+	 */
+	if (f->thread)
+		hashfile_wait(f);
+
 	if (ftruncate(f->fd, offset) ||
 	    lseek(f->fd, offset, SEEK_SET) != offset)
 		return -1;
@@ -27,6 +27,13 @@ struct hashfile {
 	 * instead only use it as a buffered write.
 	 */
 	int skip_hash;
+
+	/**
+	 * If non-NULL, full buffers are hashed and written out by
+	 * a helper thread while the caller fills the next one; see
+	 * core.checksumThread.
+	 */
+	struct hashfile_thread *thread;
 };
 
 /* Checkpoint */
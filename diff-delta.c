@@ -308,6 +308,32 @@ unsigned long sizeof_delta_index(struct delta_index *index)
 		return 0;
 }
 
+/*
+ * Return how many bytes at the start of "a" and "b" are the same, looking
+ * at no more than "limit" of them.  Matches found by create_delta() tend
+ * to be long, so compare a word at a time before finding the exact
+ * mismatching byte.
+ */
+static inline unsigned int common_prefix(const unsigned char *a,
+					 const unsigned char *b,
+					 unsigned int limit)
+{
+	unsigned int len = 0;
+
+	while (limit - len >= sizeof(uint64_t)) {
+		uint64_t x, y;
+
+		memcpy(&x, a + len, sizeof(x));
+		memcpy(&y, b + len, sizeof(y));
+		if (x != y)
+			break;
+		len += sizeof(x);
+	}
+	while (len < limit && a[len] == b[len])
+		len++;
+	return len;
+}
+
 /*
  * The maximum size for any opcode sequence, including the initial header
  * plus Rabin window plus biggest copy.
@@ -377,20 +403,18 @@ create_delta(const struct delta_index *index,
 			val = ((val << 8) | *data) ^ T[val >> RABIN_SHIFT];
 			i = val & index->hash_mask;
 			for (entry = index->hash[i]; entry < index->hash[i+1]; entry++) {
-				const unsigned char *ref = entry->ptr;
-				const unsigned char *src = data;
-				unsigned int ref_size = ref_top - ref;
+				unsigned int ref_size = ref_top - entry->ptr;
+				unsigned int len;
 				if (entry->val != val)
 					continue;
-				if (ref_size > top - src)
-					ref_size = top - src;
+				if (ref_size > top - data)
+					ref_size = top - data;
 				if (ref_size <= msize)
 					break;
-				while (ref_size-- && *src++ == *ref)
-					ref++;
-				if (msize < ref - entry->ptr) {
+				len = common_prefix(data, entry->ptr, ref_size);
+				if (msize < len) {
 					/* this is our best match so far */
-					msize = ref - entry->ptr;
+					msize = len;
 					moff = entry->ptr - ref_data;
 					if (msize >= 4096) /* good enough */
 						break;
@@ -44,6 +44,8 @@
 #include "read-cache-ll.h"
 #include "setup.h"
 #include "strmap.h"
+#include "thread-utils.h"
+#include "trace2.h"
 #include "ws.h"
 
 #ifdef NO_FAST_WORKING_DIRECTORY
@@ -55,6 +57,7 @@
 static int diff_detect_rename_default;
 static int diff_indent_heuristic = 1;
 static int diff_rename_limit_default = 1000;
+static int diff_rename_threads_default;
 static int diff_suppress_blank_empty;
 static int diff_use_color_default = -1;
 static int diff_color_moved_default;
@@ -73,6 +76,7 @@ static int diff_relative;
 static int diff_stat_name_width;
 static int diff_stat_graph_width;
 static int diff_dirstat_permille_default = 30;
+static int diff_threads = 1;
 static struct diff_options default_diff_options;
 static long diff_algorithm;
 static unsigned ws_error_highlight_default = WSEH_NEW;
@@ -489,6 +493,30 @@ int git_diff_basic_config(const char *var, const char *value,
 		return 0;
 	}
 
+	if (!strcmp(var, "diff.renamethreads")) {
+		diff_rename_threads_default = git_config_int(var, value, ctx->kvi);
+		if (diff_rename_threads_default < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    diff_rename_threads_default, var);
+		if (!HAVE_THREADS && diff_rename_threads_default > 1) {
+			warning(_("no threads support, ignoring %s"), var);
+			diff_rename_threads_default = 1;
+		}
+		return 0;
+	}
+
+	if (!strcmp(var, "diff.threads")) {
+		diff_threads = git_config_int(var, value, ctx->kvi);
+		if (diff_threads < 0)
+			die(_("invalid number of threads specified (%d) for %s"),
+			    diff_threads, var);
+		if (!HAVE_THREADS && diff_threads > 1) {
+			warning(_("no threads support, ignoring %s"), var);
+			diff_threads = 1;
+		}
+		return 0;
+	}
+
 	if (userdiff_config(var, value) < 0)
 		return -1;
 
@@ -577,6 +605,26 @@ static const struct external_diff *external_diff(void)
 	return external_diff_ptr;
 }
 
+/*
+ * The threads of diff_flush_patch_threaded() compute patches from data
+ * that has been loaded beforehand, but still need to look up attributes
+ * and abbreviate object names, neither of which is thread-safe.
+ */
+static int diff_use_locks;
+static pthread_mutex_t diff_mutex;
+
+static inline void diff_lock(void)
+{
+	if (diff_use_locks)
+		pthread_mutex_lock(&diff_mutex);
+}
+
+static inline void diff_unlock(void)
+{
+	if (diff_use_locks)
+		pthread_mutex_unlock(&diff_mutex);
+}
+
 /*
  * Keep track of files used for diffing. Sometimes such an entry
  * refers to a temporary file, sometimes to an existing file, and
@@ -1804,7 +1852,7 @@ static void emit_rewrite_diff(const char *name_a,
 			      struct diff_options *o)
 {
 	int lc_a, lc_b;
-	static struct strbuf a_name = STRBUF_INIT, b_name = STRBUF_INIT;
+	struct strbuf a_name = STRBUF_INIT, b_name = STRBUF_INIT;
 	const char *a_prefix, *b_prefix;
 	char *data_one, *data_two;
 	size_t size_one, size_two;
@@ -1822,8 +1870,6 @@ static void emit_rewrite_diff(const char *name_a,
 	name_a += (*name_a == '/');
 	name_b += (*name_b == '/');
 
-	strbuf_reset(&a_name);
-	strbuf_reset(&b_name);
 	quote_two_c_style(&a_name, a_prefix, name_a, 0);
 	quote_two_c_style(&b_name, b_prefix, name_b, 0);
 
@@ -1832,7 +1878,9 @@ static void emit_rewrite_diff(const char *name_a,
 
 	memset(&ecbdata, 0, sizeof(ecbdata));
 	ecbdata.color_diff = want_color(o->use_color);
+	diff_lock();
 	ecbdata.ws_rule = whitespace_rule(o->repo->index, name_b);
+	diff_unlock();
 	ecbdata.opt = o;
 	if (ecbdata.ws_rule & WS_BLANK_AT_EOF) {
 		mmfile_t mf1, mf2;
@@ -1872,6 +1920,8 @@ static void emit_rewrite_diff(const char *name_a,
 		free((char *)data_one);
 	if (textconv_two)
 		free((char *)data_two);
+	strbuf_release(&a_name);
+	strbuf_release(&b_name);
 }
 
 struct diff_words_buffer {
@@ -3425,6 +3475,13 @@ int diff_filespec_is_binary(struct repository *r,
 	return one->is_binary;
 }
 
+int diff_filespec_driver_binary(struct repository *r,
+				struct diff_filespec *one)
+{
+	diff_filespec_load_driver(one, r->index);
+	return one->driver->binary;
+}
+
 static const struct userdiff_funcname *
 diff_funcname_pattern(struct diff_options *o, struct diff_filespec *one)
 {
@@ -3729,13 +3786,16 @@ static void builtin_diff(const char *name_a,
 			lbl[0] = NULL;
 		ecbdata.label_path = lbl;
 		ecbdata.color_diff = want_color(o->use_color);
+		diff_lock();
 		ecbdata.ws_rule = whitespace_rule(o->repo->index, name_b);
+		diff_unlock();
 		if (ecbdata.ws_rule & WS_BLANK_AT_EOF)
 			check_blank_at_eof(&mf1, &mf2, &ecbdata);
 		ecbdata.opt = o;
 		if (header.len && !o->flags.suppress_diff_headers)
 			ecbdata.header = &header;
 		xpp.flags = o->xdl_opts;
+		xpp.arena = o->xdl_arena;
 		xpp.ignore_regex = o->ignore_regex;
 		xpp.ignore_regex_nr = o->ignore_regex_nr;
 		xpp.anchors = o->anchors;
@@ -3871,6 +3931,7 @@ static void builtin_diffstat(const char *name_a, const char *name_b,
 		xpp.ignore_regex_nr = o->ignore_regex_nr;
 		xpp.anchors = o->anchors;
 		xpp.anchors_nr = o->anchors_nr;
+		xpp.arena = o->xdl_arena;
 		xecfg.ctxlen = o->context;
 		xecfg.interhunkctxlen = o->interhunkcontext;
 		xecfg.flags = XDL_EMIT_NO_HUNK_HDR;
@@ -4539,9 +4600,11 @@ static void fill_metainfo(struct strbuf *msg,
 			     diff_filespec_is_binary(o->repo, two)))
 				abbrev = hexsz;
 		}
+		diff_lock();
 		strbuf_addf(msg, "%s%sindex %s..%s", line_prefix, set,
 			    diff_abbrev_oid(&one->oid, abbrev),
 			    diff_abbrev_oid(&two->oid, abbrev));
+		diff_unlock();
 		if (one->mode == two->mode)
 			strbuf_addf(msg, " %06o", one->mode);
 		strbuf_addf(msg, "%s\n", reset);
@@ -4563,8 +4626,11 @@ static void run_diff_cmd(const struct external_diff *pgm,
 	int must_show_header = 0;
 	struct userdiff_driver *drv = NULL;
 
-	if (o->flags.allow_external || !o->ignore_driver_algorithm)
+	if (o->flags.allow_external || !o->ignore_driver_algorithm) {
+		diff_lock();
 		drv = userdiff_find_by_path(o->repo->index, attr_path);
+		diff_unlock();
+	}
 
 	if (o->flags.allow_external && drv && drv->external.cmd)
 		pgm = &drv->external;
@@ -4760,6 +4826,7 @@ void repo_diff_setup(struct repository *r, struct diff_options *options)
 	options->line_termination = '\n';
 	options->break_opt = -1;
 	options->rename_limit = -1;
+	options->rename_threads = diff_rename_threads_default;
 	options->dirstat_permille = diff_dirstat_permille_default;
 	options->context = diff_context_default;
 	options->interhunkcontext = diff_interhunk_context_default;
@@ -6655,9 +6722,221 @@ static void create_filepairs_for_header_only_notifications(struct diff_options *
 	strset_clear(&present);
 }
 
-static void diff_flush_patch_all_file_pairs(struct diff_options *o)
+/*
+ * Number of file pairs whose patches are computed in parallel before
+ * being shown, per thread.  All of their contents are held in memory
+ * at the same time.
+ */
+#define DIFF_PATCH_BATCH 16
+
+struct threaded_patch {
+	struct diff_filepair *p;
+	struct emitted_diff_symbols esm;
+	unsigned threaded:1,
+		 found_changes:1;
+};
+
+struct patch_thread_data {
+	pthread_t pthread;
+	struct diff_options *o;
+	struct threaded_patch *patch;
+	int nr, *next;
+};
+
+/*
+ * Load everything the patch of "p" needs that cannot be done by a
+ * worker thread, and tell whether it can be computed by one.  Pairs
+ * that involve anything but regular files, that share their filespecs
+ * with another pair (copies), or that need textconv or an external diff
+ * driver are shown by the main thread, as before.
+ */
+static int prepare_threaded_patch(struct diff_filepair *p,
+				  struct diff_options *o)
+{
+	struct diff_filespec *one = p->one, *two = p->two;
+	struct index_state *istate = o->repo->index;
+	struct userdiff_driver *drv;
+
+	if (DIFF_PAIR_UNMERGED(p) || diff_unmodified_pair(p) ||
+	    (DIFF_FILE_VALID(one) && (!S_ISREG(one->mode) || one->count > 1)) ||
+	    (DIFF_FILE_VALID(two) && (!S_ISREG(two->mode) || two->count > 1)))
+		return 0;
+
+	/*
+	 * run_diff() hashes worktree files whose object name we do not
+	 * know yet, which goes through the attributes and clean filters;
+	 * neither may be used from several threads at once.
+	 */
+	if ((DIFF_FILE_VALID(one) && !one->oid_valid) ||
+	    (DIFF_FILE_VALID(two) && !two->oid_valid))
+		return 0;
+
+	drv = userdiff_find_by_path(istate, one->path);
+	if (o->flags.allow_external && drv && drv->external.cmd)
+		return 0;
+	if (o->flags.allow_textconv &&
+	    (get_textconv(o->repo, one) || get_textconv(o->repo, two)))
+		return 0;
+
+	diff_fill_oid_info(one, istate);
+	diff_fill_oid_info(two, istate);
+	diff_filespec_load_driver(one, istate);
+	diff_filespec_load_driver(two, istate);
+	if ((DIFF_FILE_VALID(one) && diff_populate_filespec(o->repo, one, NULL)) ||
+	    (DIFF_FILE_VALID(two) && diff_populate_filespec(o->repo, two, NULL)))
+		return 0;
+
+	/* this is computed on first use and cached in the filespec */
+	if (DIFF_FILE_VALID(one))
+		diff_filespec_is_binary(o->repo, one);
+	if (DIFF_FILE_VALID(two))
+		diff_filespec_is_binary(o->repo, two);
+	return 1;
+}
+
+static void *run_patch_thread(void *_data)
+{
+	struct patch_thread_data *data = _data;
+	xdlarena_t arena = XDL_ARENA_INIT;
+
+	for (;;) {
+		struct threaded_patch *t;
+		struct diff_options o;
+
+		diff_lock();
+		while (*data->next < data->nr && !data->patch[*data->next].threaded)
+			(*data->next)++;
+		t = *data->next < data->nr ? &data->patch[(*data->next)++] : NULL;
+		diff_unlock();
+		if (!t)
+			break;
+
+		memcpy(&o, data->o, sizeof(o));
+		o.emitted_symbols = &t->esm;
+		o.xdl_arena = &arena;
+		o.found_changes = 0;
+		diff_flush_patch(t->p, &o);
+		t->found_changes = o.found_changes;
+	}
+
+	xdl_arena_release(&arena);
+	return NULL;
+}
+
+static void emit_threaded_patch(struct diff_options *o,
+				struct threaded_patch *t)
 {
 	int i;
+
+	for (i = 0; i < t->esm.nr; i++) {
+		struct emitted_diff_symbol *e = &t->esm.buf[i];
+
+		if (o->emitted_symbols) {
+			/* hand the line over to the buffer of --color-moved */
+			ALLOC_GROW(o->emitted_symbols->buf,
+				   o->emitted_symbols->nr + 1,
+				   o->emitted_symbols->alloc);
+			o->emitted_symbols->buf[o->emitted_symbols->nr++] = *e;
+		} else {
+			emit_diff_symbol_from_struct(o, e);
+			free((void *)e->line);
+		}
+	}
+	t->esm.nr = 0;
+	if (t->found_changes)
+		o->found_changes = 1;
+}
+
+/*
+ * Compute the patches of a batch of file pairs on several threads,
+ * each into its own buffer, and then show them in order, so that the
+ * output is the same as when they are computed one after the other.
+ */
+static void diff_flush_patch_threaded(struct diff_options *o, int nr_threads)
+{
+	struct diff_queue_struct *q = &diff_queued_diff;
+	struct patch_thread_data *data;
+	struct threaded_patch *patch;
+	int batch = nr_threads * DIFF_PATCH_BATCH;
+	int start, i, total = 0;
+
+	/* prime what the threads would otherwise initialize lazily */
+	want_color(o->use_color);
+	external_diff();
+
+	CALLOC_ARRAY(patch, batch);
+	CALLOC_ARRAY(data, nr_threads);
+	pthread_mutex_init(&diff_mutex, NULL);
+
+	for (start = 0; start < q->nr; start += batch) {
+		int nr = 0, nr_threaded = 0, next = 0;
+
+		for (i = start; i < q->nr && i < start + batch; i++) {
+			struct diff_filepair *p = q->queue[i];
+
+			if (!check_pair_status(p))
+				continue;
+			patch[nr].p = p;
+			patch[nr].threaded = prepare_threaded_patch(p, o);
+			patch[nr].found_changes = 0;
+			nr_threaded += patch[nr].threaded;
+			nr++;
+		}
+
+		if (nr_threaded > 1) {
+			diff_use_locks = 1;
+			for (i = 0; i < nr_threads; i++) {
+				data[i].o = o;
+				data[i].patch = patch;
+				data[i].nr = nr;
+				data[i].next = &next;
+				if (pthread_create(&data[i].pthread, NULL,
+						   run_patch_thread, &data[i]))
+					die(_("unable to create thread"));
+			}
+			for (i = 0; i < nr_threads; i++)
+				if (pthread_join(data[i].pthread, NULL))
+					die(_("unable to join thread"));
+			diff_use_locks = 0;
+			total += nr_threaded;
+		}
+
+		for (i = 0; i < nr; i++) {
+			if (nr_threaded > 1 && patch[i].threaded)
+				emit_threaded_patch(o, &patch[i]);
+			else
+				diff_flush_patch(patch[i].p, o);
+		}
+	}
+
+	if (total)
+		trace2_data_intmax("diff", o->repo, "patch/threaded", total);
+
+	pthread_mutex_destroy(&diff_mutex);
+	for (i = 0; i < batch; i++)
+		free(patch[i].esm.buf);
+	free(patch);
+	free(data);
+}
+
+static int diff_patch_threads(struct diff_options *o)
+{
+	int nr = diff_threads;
+
+	if (!HAVE_THREADS)
+		return 1;
+	if (!nr)
+		nr = online_cpus();
+	/* these need state that is not safe to share between threads */
+	if (nr > 1 && (o->output_prefix ||
+		       (o->flags.allow_external && external_diff())))
+		nr = 1;
+	return nr;
+}
+
+static void diff_flush_patch_all_file_pairs(struct diff_options *o)
+{
+	int i, nr_threads;
 	static struct emitted_diff_symbols esm = EMITTED_DIFF_SYMBOLS_INIT;
 	struct diff_queue_struct *q = &diff_queued_diff;
 
@@ -6670,11 +6949,15 @@ static void diff_flush_patch_all_file_pairs(struct diff_options *o)
 	if (o->additional_path_headers)
 		create_filepairs_for_header_only_notifications(o);
 
-	for (i = 0; i < q->nr; i++) {
-		struct diff_filepair *p = q->queue[i];
-		if (check_pair_status(p))
-			diff_flush_patch(p, o);
-	}
+	nr_threads = diff_patch_threads(o);
+	if (nr_threads > 1)
+		diff_flush_patch_threaded(o, nr_threads);
+	else
+		for (i = 0; i < q->nr; i++) {
+			struct diff_filepair *p = q->queue[i];
+			if (check_pair_status(p))
+				diff_flush_patch(p, o);
+		}
 
 	if (o->emitted_symbols) {
 		if (o->color_moved) {
@@ -6751,6 +7034,7 @@ void diff_flush(struct diff_options *options)
 	int i, output_format = options->output_format;
 	int separator = 0;
 	int dirstat_by_line = 0;
+	xdlarena_t arena = XDL_ARENA_INIT;
 
 	/*
 	 * Order: raw, stat, summary, patch
@@ -6759,6 +7043,9 @@ void diff_flush(struct diff_options *options)
 	if (!q->nr && !options->additional_path_headers)
 		goto free_queue;
 
+	if (!options->xdl_arena)
+		options->xdl_arena = &arena;
+
 	if (output_format & (DIFF_FORMAT_RAW |
 			     DIFF_FORMAT_NAME |
 			     DIFF_FORMAT_NAME_STATUS |
@@ -6837,6 +7124,9 @@ void diff_flush(struct diff_options *options)
 	}
 
 free_queue:
+	if (options->xdl_arena == &arena)
+		options->xdl_arena = NULL;
+	xdl_arena_release(&arena);
 	diff_queue_clear(q);
 	diff_free(options);
 
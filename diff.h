@@ -72,6 +72,7 @@ struct oid_array;
 struct option;
 struct repository;
 struct rev_info;
+struct s_xdlarena;
 struct userdiff_driver;
 
 typedef int (*pathchange_fn_t)(struct diff_options *options,
@@ -309,6 +310,8 @@ struct diff_options {
 	 */
 	int rename_score;
 	int rename_limit;
+	/* Threads for inexact rename detection; 0 means one per core. */
+	int rename_threads;
 
 	int needed_rename_limit;
 	int degraded_cc_to_c;
@@ -396,6 +399,12 @@ struct diff_options {
 	struct repository *repo;
 	struct strmap *additional_path_headers;
 
+	/*
+	 * Memory reused by the line-level diffs of all the file pairs
+	 * shown by one diff_flush().
+	 */
+	struct s_xdlarena *xdl_arena;
+
 	int no_free;
 };
 
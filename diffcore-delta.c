@@ -1,5 +1,7 @@
 #include "git-compat-util.h"
 #include "diffcore.h"
+#include "oidmap.h"
+#include "xdiff-interface.h"
 
 /*
  * Idea here is very simple.
@@ -120,6 +122,101 @@ static int spanhash_cmp(const void *a_, const void *b_)
 		a->hashval > b->hashval ? 1 : 0;
 }
 
+/*
+ * Blob contents never change, so the signature hash_chars() computes
+ * for a blob can be reused whenever the same blob is compared again,
+ * e.g. by rename detection for the next commit of "git log -M" or the
+ * next merge of a rebase.  We keep a copy of each signature, without
+ * its empty buckets, keyed by the name of the blob.
+ *
+ * The signature also depends on whether the blob is treated as text,
+ * which the diff driver of its path may decide instead of its contents,
+ * so we record both how it was hashed and what the contents say.
+ */
+struct spanhash_cache_entry {
+	struct oidmap_entry entry;
+	unsigned is_text : 1;
+	unsigned content_is_binary : 1;
+	size_t nr;
+	struct spanhash data[FLEX_ARRAY];
+};
+
+/* Start over when the cache grows beyond this many bytes */
+#define SPANHASH_CACHE_LIMIT (64 * 1024 * 1024)
+
+static struct oidmap spanhash_cache = OIDMAP_INIT;
+static size_t spanhash_cache_bytes;
+
+static int spanhash_cacheable(struct diff_filespec *one)
+{
+	return one->oid_valid && S_ISREG(one->mode) && !is_null_oid(&one->oid);
+}
+
+static void cache_spanhash(struct diff_filespec *one, int is_text,
+			   struct spanhash_top *hash)
+{
+	struct spanhash_cache_entry *e;
+	size_t nr = 0, bytes;
+
+	if (!spanhash_cacheable(one) || !one->data)
+		return;
+
+	while (nr < ((size_t)1 << hash->alloc_log2) && hash->data[nr].cnt)
+		nr++;
+	bytes = st_add(sizeof(*e), st_mult(sizeof(struct spanhash), nr + 1));
+	if (bytes > SPANHASH_CACHE_LIMIT)
+		return;
+	if (spanhash_cache_bytes + bytes > SPANHASH_CACHE_LIMIT) {
+		oidmap_free(&spanhash_cache, 1);
+		oidmap_init(&spanhash_cache, 0);
+		spanhash_cache_bytes = 0;
+	}
+
+	e = xcalloc(1, bytes);
+	oidcpy(&e->entry.oid, &one->oid);
+	e->is_text = is_text;
+	e->content_is_binary = buffer_is_binary(one->data, one->size);
+	e->nr = nr;
+	COPY_ARRAY(e->data, hash->data, nr);
+	free(oidmap_put(&spanhash_cache, e));
+	spanhash_cache_bytes += bytes;
+}
+
+static struct spanhash_top *cached_spanhash(struct repository *r,
+					    struct diff_filespec *one)
+{
+	struct spanhash_cache_entry *e;
+	struct spanhash_top *hash;
+	int binary;
+
+	if (!spanhash_cacheable(one))
+		return NULL;
+	e = oidmap_get(&spanhash_cache, &one->oid);
+	if (!e)
+		return NULL;
+
+	binary = diff_filespec_driver_binary(r, one);
+	if (binary == -1)
+		binary = e->content_is_binary;
+	if (e->is_text == binary)
+		return NULL;
+	if (one->is_binary == -1)
+		one->is_binary = binary;
+
+	hash = xcalloc(1, st_add(sizeof(*hash),
+				 st_mult(sizeof(struct spanhash), e->nr + 1)));
+	COPY_ARRAY(hash->data, e->data, e->nr);
+	return hash;
+}
+
+int diffcore_load_cached_count(struct repository *r,
+			       struct diff_filespec *one)
+{
+	if (!one->cnt_data)
+		one->cnt_data = cached_spanhash(r, one);
+	return !!one->cnt_data;
+}
+
 static struct spanhash_top *hash_chars(struct repository *r,
 				       struct diff_filespec *one)
 {
@@ -163,9 +260,18 @@ static struct spanhash_top *hash_chars(struct repository *r,
 		hash = add_spanhash(hash, hashval, n);
 	}
 	QSORT(hash->data, (size_t)1ul << hash->alloc_log2, spanhash_cmp);
+	cache_spanhash(one, is_text, hash);
 	return hash;
 }
 
+void diffcore_load_count(struct repository *r, struct diff_filespec *one)
+{
+	if (!one->cnt_data)
+		one->cnt_data = cached_spanhash(r, one);
+	if (!one->cnt_data)
+		one->cnt_data = hash_chars(r, one);
+}
+
 int diffcore_count_changes(struct repository *r,
 			   struct diff_filespec *src,
 			   struct diff_filespec *dst,
@@ -182,14 +288,18 @@ int diffcore_count_changes(struct repository *r,
 	if (src_count_p)
 		src_count = *src_count_p;
 	if (!src_count) {
-		src_count = hash_chars(r, src);
+		src_count = cached_spanhash(r, src);
+		if (!src_count)
+			src_count = hash_chars(r, src);
 		if (src_count_p)
 			*src_count_p = src_count;
 	}
 	if (dst_count_p)
 		dst_count = *dst_count_p;
 	if (!dst_count) {
-		dst_count = hash_chars(r, dst);
+		dst_count = cached_spanhash(r, dst);
+		if (!dst_count)
+			dst_count = hash_chars(r, dst);
 		if (dst_count_p)
 			*dst_count_p = dst_count;
 	}
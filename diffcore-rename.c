@@ -12,10 +12,12 @@
 #include "hashmap.h"
 #include "mem-pool.h"
 #include "oid-array.h"
+#include "parse.h"
 #include "progress.h"
 #include "promisor-remote.h"
 #include "string-list.h"
 #include "strmap.h"
+#include "thread-utils.h"
 #include "trace2.h"
 
 /* Table of rename/copy destinations */
@@ -129,6 +131,49 @@ static void inexact_prefetch(void *prefetch_options)
 	oid_array_clear(&to_fetch);
 }
 
+/*
+ * We would not consider edits that change the file size so
+ * drastically.  delta_size must be smaller than
+ * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
+ *
+ * Note that base_size == 0 case is handled here already
+ * and the score computation in similarity_score() would not
+ * have a divide-by-zero issue.
+ */
+static int similar_size(struct diff_filespec *src, struct diff_filespec *dst,
+			int minimum_score)
+{
+	unsigned long max_size, delta_size, base_size;
+
+	max_size = ((src->size > dst->size) ? src->size : dst->size);
+	base_size = ((src->size < dst->size) ? src->size : dst->size);
+	delta_size = max_size - base_size;
+
+	return max_size * (MAX_SCORE-minimum_score) >= delta_size * MAX_SCORE;
+}
+
+/*
+ * How similar are they?  What percentage of material in dst
+ * is from source?  Both sides must have their size and either
+ * their contents or their "cnt_data" loaded.
+ */
+static int similarity_score(struct repository *r,
+			    struct diff_filespec *src,
+			    struct diff_filespec *dst)
+{
+	unsigned long max_size, src_copied, literal_added;
+
+	if (diffcore_count_changes(r, src, dst,
+				   &src->cnt_data, &dst->cnt_data,
+				   &src_copied, &literal_added))
+		return 0;
+
+	max_size = ((src->size > dst->size) ? src->size : dst->size);
+	if (!dst->size)
+		return 0; /* should not happen */
+	return (int)(src_copied * MAX_SCORE / max_size);
+}
+
 static int estimate_similarity(struct repository *r,
 			       struct diff_filespec *src,
 			       struct diff_filespec *dst,
@@ -148,9 +193,6 @@ static int estimate_similarity(struct repository *r,
 	 * match than anything else; the destination does not even
 	 * call into this function in that case.
 	 */
-	unsigned long max_size, delta_size, base_size, src_copied, literal_added;
-	int score;
-
 	/* We deal only with regular files.  Symlink renames are handled
 	 * only when they are exact matches --- in other words, no edits
 	 * after renaming.
@@ -176,41 +218,19 @@ static int estimate_similarity(struct repository *r,
 	    diff_populate_filespec(r, dst, dpf_opt))
 		return 0;
 
-	max_size = ((src->size > dst->size) ? src->size : dst->size);
-	base_size = ((src->size < dst->size) ? src->size : dst->size);
-	delta_size = max_size - base_size;
-
-	/* We would not consider edits that change the file size so
-	 * drastically.  delta_size must be smaller than
-	 * (MAX_SCORE-minimum_score)/MAX_SCORE * min(src->size, dst->size).
-	 *
-	 * Note that base_size == 0 case is handled here already
-	 * and the final score computation below would not have a
-	 * divide-by-zero issue.
-	 */
-	if (max_size * (MAX_SCORE-minimum_score) < delta_size * MAX_SCORE)
+	if (!similar_size(src, dst, minimum_score))
 		return 0;
 
 	dpf_opt->check_size_only = 0;
 
-	if (!src->cnt_data && diff_populate_filespec(r, src, dpf_opt))
-		return 0;
-	if (!dst->cnt_data && diff_populate_filespec(r, dst, dpf_opt))
+	if (!diffcore_load_cached_count(r, src) &&
+	    diff_populate_filespec(r, src, dpf_opt))
 		return 0;
-
-	if (diffcore_count_changes(r, src, dst,
-				   &src->cnt_data, &dst->cnt_data,
-				   &src_copied, &literal_added))
+	if (!diffcore_load_cached_count(r, dst) &&
+	    diff_populate_filespec(r, dst, dpf_opt))
 		return 0;
 
-	/* How similar are they?
-	 * what percentage of material in dst are from source?
-	 */
-	if (!dst->size)
-		score = 0; /* should not happen */
-	else
-		score = (int)(src_copied * MAX_SCORE / max_size);
-	return score;
+	return similarity_score(r, src, dst);
 }
 
 static void record_rename_pair(int dst_index, int src_index, int score)
@@ -1378,6 +1398,223 @@ void pool_diff_free_filepair(struct mem_pool *pool,
 	free_filespec_data(p->two);
 }
 
+/*
+ * Once the size and the signature of every candidate are loaded,
+ * scoring a (src, dst) pair does not need the object store anymore,
+ * so the similarity matrix can be filled in by several threads.  Each
+ * thread takes whole destinations, so the candidates recorded for
+ * every destination are the same as when they are computed serially.
+ *
+ * We want at least this many pairs to score per thread.
+ */
+#define RENAME_THREAD_COST (10000)
+
+static int rename_threads(int requested, int num_destinations, int num_sources)
+{
+	uint64_t nr_pairs = (uint64_t)num_destinations * num_sources;
+	int nr;
+
+	if (!HAVE_THREADS)
+		return 1;
+	nr = requested ? requested : online_cpus();
+	if (git_env_bool("GIT_TEST_RENAME_THREADS", 0))
+		nr = nr < 2 ? 2 : nr;
+	else if (!requested && nr_pairs < (uint64_t)nr * RENAME_THREAD_COST)
+		nr = nr_pairs / RENAME_THREAD_COST;
+	return num_destinations < nr ? num_destinations : nr;
+}
+
+static void load_rename_signature(struct repository *r,
+				  struct diff_filespec *one,
+				  struct diff_populate_filespec_options *dpf_opt)
+{
+	if (!diffcore_load_cached_count(r, one) &&
+	    !diff_populate_filespec(r, one, dpf_opt))
+		diffcore_load_count(r, one);
+	diff_free_filespec_blob(one);
+}
+
+/*
+ * Load the size of every regular file we are going to compare, and the
+ * signature of those whose size is close enough to that of at least one
+ * file on the other side for estimate_similarity() to look at their
+ * contents.  Files we cannot read are left without "cnt_data".
+ */
+static void load_rename_signatures(struct repository *r,
+				   int skip_unmodified, int minimum_score,
+				   struct diff_populate_filespec_options *dpf_opt)
+{
+	unsigned char *src_state, *dst_state;
+	int i, j;
+
+	CALLOC_ARRAY(src_state, rename_src_nr);
+	CALLOC_ARRAY(dst_state, rename_dst_nr);
+
+	dpf_opt->check_size_only = 1;
+	for (j = 0; j < rename_src_nr; j++) {
+		struct diff_filespec *one = rename_src[j].p->one;
+
+		if (skip_unmodified && diff_unmodified_pair(rename_src[j].p))
+			continue;
+		if (!S_ISREG(one->mode))
+			continue;
+		if (!one->cnt_data && diff_populate_filespec(r, one, dpf_opt))
+			continue;
+		src_state[j] = 1;
+	}
+	for (i = 0; i < rename_dst_nr; i++) {
+		struct diff_filespec *two = rename_dst[i].p->two;
+
+		if (rename_dst[i].is_rename || !S_ISREG(two->mode))
+			continue;
+		if (!two->cnt_data && diff_populate_filespec(r, two, dpf_opt))
+			continue;
+		dst_state[i] = 1;
+	}
+
+	for (i = 0; i < rename_dst_nr; i++) {
+		if (!dst_state[i])
+			continue;
+		for (j = 0; j < rename_src_nr; j++) {
+			if (!src_state[j] ||
+			    !similar_size(rename_src[j].p->one,
+					  rename_dst[i].p->two, minimum_score))
+				continue;
+			src_state[j] = dst_state[i] = 2;
+		}
+	}
+
+	dpf_opt->check_size_only = 0;
+	for (j = 0; j < rename_src_nr; j++)
+		if (src_state[j] == 2)
+			load_rename_signature(r, rename_src[j].p->one, dpf_opt);
+	for (i = 0; i < rename_dst_nr; i++)
+		if (dst_state[i] == 2)
+			load_rename_signature(r, rename_dst[i].p->two, dpf_opt);
+
+	free(src_state);
+	free(dst_state);
+}
+
+struct rename_progress {
+	struct progress *progress;
+	uint64_t n;
+	pthread_mutex_t mutex;
+};
+
+struct rename_thread_data {
+	pthread_t pthread;
+	struct repository *repo;
+	struct diff_score *mx;
+	const int *dsts;
+	int nr_dsts, offset, stride;
+	int num_sources;
+	int minimum_score;
+	int skip_unmodified;
+	int want_copies;
+	struct rename_progress *progress;
+};
+
+static void *score_destinations(void *_data)
+{
+	struct rename_thread_data *data = _data;
+	int row, j;
+
+	for (row = data->offset; row < data->nr_dsts; row += data->stride) {
+		int i = data->dsts[row];
+		struct diff_filespec *two = rename_dst[i].p->two;
+		struct diff_score *m = &data->mx[row * NUM_CANDIDATE_PER_DST];
+
+		for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
+			m[j].dst = -1;
+
+		for (j = 0; j < rename_src_nr; j++) {
+			struct diff_filespec *one = rename_src[j].p->one;
+			struct diff_score this_src;
+
+			assert(!one->rename_used || data->want_copies ||
+			       break_idx);
+
+			if (data->skip_unmodified &&
+			    diff_unmodified_pair(rename_src[j].p))
+				continue;
+
+			/*
+			 * load_rename_signatures() loaded everything
+			 * that estimate_similarity() would have looked
+			 * at; anything without a signature would have
+			 * scored 0 there as well.
+			 */
+			if (!S_ISREG(one->mode) || !S_ISREG(two->mode) ||
+			    !one->cnt_data || !two->cnt_data ||
+			    !similar_size(one, two, data->minimum_score))
+				this_src.score = 0;
+			else
+				this_src.score = similarity_score(data->repo,
+								  one, two);
+			this_src.name_score = basename_same(one, two);
+			this_src.dst = i;
+			this_src.src = j;
+			record_if_better(m, &this_src);
+		}
+
+		if (data->progress->progress) {
+			pthread_mutex_lock(&data->progress->mutex);
+			data->progress->n += data->num_sources;
+			display_progress(data->progress->progress,
+					 data->progress->n);
+			pthread_mutex_unlock(&data->progress->mutex);
+		}
+	}
+	return NULL;
+}
+
+static int score_destinations_threaded(struct repository *r,
+				       struct diff_score *mx,
+				       int nr_threads, int num_sources,
+				       int minimum_score, int skip_unmodified,
+				       int want_copies,
+				       struct progress *progress)
+{
+	struct rename_thread_data *data;
+	struct rename_progress pd = { .progress = progress };
+	int *dsts;
+	int i, dst_cnt = 0;
+
+	ALLOC_ARRAY(dsts, rename_dst_nr);
+	for (i = 0; i < rename_dst_nr; i++)
+		if (!rename_dst[i].is_rename)
+			dsts[dst_cnt++] = i;
+
+	pthread_mutex_init(&pd.mutex, NULL);
+	CALLOC_ARRAY(data, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		struct rename_thread_data *d = &data[i];
+
+		d->repo = r;
+		d->mx = mx;
+		d->dsts = dsts;
+		d->nr_dsts = dst_cnt;
+		d->offset = i;
+		d->stride = nr_threads;
+		d->num_sources = num_sources;
+		d->minimum_score = minimum_score;
+		d->skip_unmodified = skip_unmodified;
+		d->want_copies = want_copies;
+		d->progress = &pd;
+		if (pthread_create(&d->pthread, NULL, score_destinations, d))
+			die(_("unable to create thread"));
+	}
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_join(data[i].pthread, NULL))
+			die(_("unable to join thread"));
+
+	pthread_mutex_destroy(&pd.mutex);
+	free(data);
+	free(dsts);
+	return dst_cnt;
+}
+
 void diffcore_rename_extended(struct diff_options *options,
 			      struct mem_pool *pool,
 			      struct strintmap *relevant_sources,
@@ -1391,7 +1628,7 @@ void diffcore_rename_extended(struct diff_options *options,
 	struct diff_queue_struct outq = DIFF_QUEUE_INIT;
 	struct diff_score *mx;
 	int i, j, rename_count, skip_unmodified = 0;
-	int num_destinations, dst_cnt;
+	int num_destinations, dst_cnt, nr_threads;
 	int num_sources, want_copies;
 	struct progress *progress = NULL;
 	struct mem_pool local_pool;
@@ -1580,45 +1817,57 @@ void diffcore_rename_extended(struct diff_options *options,
 	}
 
 	CALLOC_ARRAY(mx, st_mult(NUM_CANDIDATE_PER_DST, num_destinations));
-	for (dst_cnt = i = 0; i < rename_dst_nr; i++) {
-		struct diff_filespec *two = rename_dst[i].p->two;
-		struct diff_score *m;
-
-		if (rename_dst[i].is_rename)
-			continue; /* exact or basename match already handled */
-
-		m = &mx[dst_cnt * NUM_CANDIDATE_PER_DST];
-		for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
-			m[j].dst = -1;
-
-		for (j = 0; j < rename_src_nr; j++) {
-			struct diff_filespec *one = rename_src[j].p->one;
-			struct diff_score this_src;
-
-			assert(!one->rename_used || want_copies || break_idx);
-
-			if (skip_unmodified &&
-			    diff_unmodified_pair(rename_src[j].p))
-				continue;
-
-			this_src.score = estimate_similarity(options->repo,
-							     one, two,
-							     minimum_score,
-							     &dpf_options);
-			this_src.name_score = basename_same(one, two);
-			this_src.dst = i;
-			this_src.src = j;
-			record_if_better(m, &this_src);
-			/*
-			 * Once we run estimate_similarity,
-			 * We do not need the text anymore.
-			 */
-			diff_free_filespec_blob(one);
-			diff_free_filespec_blob(two);
+	nr_threads = rename_threads(options->rename_threads,
+				    num_destinations, num_sources);
+	if (nr_threads > 1) {
+		load_rename_signatures(options->repo, skip_unmodified,
+				       minimum_score, &dpf_options);
+		dst_cnt = score_destinations_threaded(options->repo, mx,
+						      nr_threads, num_sources,
+						      minimum_score,
+						      skip_unmodified,
+						      want_copies, progress);
+	} else {
+		for (dst_cnt = i = 0; i < rename_dst_nr; i++) {
+			struct diff_filespec *two = rename_dst[i].p->two;
+			struct diff_score *m;
+
+			if (rename_dst[i].is_rename)
+				continue; /* exact or basename match already handled */
+
+			m = &mx[dst_cnt * NUM_CANDIDATE_PER_DST];
+			for (j = 0; j < NUM_CANDIDATE_PER_DST; j++)
+				m[j].dst = -1;
+
+			for (j = 0; j < rename_src_nr; j++) {
+				struct diff_filespec *one = rename_src[j].p->one;
+				struct diff_score this_src;
+
+				assert(!one->rename_used || want_copies || break_idx);
+
+				if (skip_unmodified &&
+				    diff_unmodified_pair(rename_src[j].p))
+					continue;
+
+				this_src.score = estimate_similarity(options->repo,
+								     one, two,
+								     minimum_score,
+								     &dpf_options);
+				this_src.name_score = basename_same(one, two);
+				this_src.dst = i;
+				this_src.src = j;
+				record_if_better(m, &this_src);
+				/*
+				 * Once we run estimate_similarity,
+				 * We do not need the text anymore.
+				 */
+				diff_free_filespec_blob(one);
+				diff_free_filespec_blob(two);
+			}
+			dst_cnt++;
+			display_progress(progress,
+					 (uint64_t)dst_cnt * (uint64_t)num_sources);
 		}
-		dst_cnt++;
-		display_progress(progress,
-				 (uint64_t)dst_cnt * (uint64_t)num_sources);
 	}
 	stop_progress(&progress);
 
@@ -92,6 +92,13 @@ void diff_free_filespec_data(struct diff_filespec *);
 void diff_free_filespec_blob(struct diff_filespec *);
 int diff_filespec_is_binary(struct repository *, struct diff_filespec *);
 
+/*
+ * Return whether the diff driver configured for the path of the filespec
+ * says it is binary (1) or text (0), or -1 if that is decided by looking
+ * at its contents.
+ */
+int diff_filespec_driver_binary(struct repository *, struct diff_filespec *);
+
 /**
  * This records a pair of `struct diff_filespec`; the filespec for a file in
  * the "old" set (i.e. preimage) is called `one`, and the filespec for a file
@@ -225,6 +232,20 @@ int diffcore_count_changes(struct repository *r,
 			   unsigned long *src_copied,
 			   unsigned long *literal_added);
 
+/*
+ * Fill in the "cnt_data" of a filespec from the signatures that
+ * diffcore_count_changes() computed for the same blob earlier in this
+ * process, without reading its contents.  Return 1 if it was found.
+ */
+int diffcore_load_cached_count(struct repository *r,
+			       struct diff_filespec *one);
+
+/*
+ * Fill in the "cnt_data" of a filespec whose contents are loaded, so
+ * that diffcore_count_changes() does not need them anymore.
+ */
+void diffcore_load_count(struct repository *r, struct diff_filespec *one);
+
 /*
  * If filespec contains an OID and if that object is missing from the given
  * repository, add that OID to to_fetch.
@@ -17,11 +17,159 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 #include "git-compat-util.h"
+#include "parse.h"
+#include "thread-utils.h"
 #include "ewok.h"
+#include "ewok_rlw.h"
+
+/*
+ * Most x86 CPUs made since 2013 have AVX2, with which the loops over the
+ * words of an uncompressed bitmap below can handle four words at a time.
+ * As with the SHA extensions in sha256/block/sha256.c, we compile those
+ * versions whenever the compiler can target AVX2 on a per-function basis,
+ * and use them only if the CPU we run on turns out to support it.
+ */
+#if !defined(NO_EWAH_AVX2) && (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || GIT_GNUC_PREREQ(4, 9))
+#define EWAH_AVX2
+#include <immintrin.h>
+#endif
 
 #define EWAH_MASK(x) ((eword_t)1 << (x % BITS_IN_EWORD))
 #define EWAH_BLOCK(x) (x / BITS_IN_EWORD)
 
+struct word_kernels {
+	const char *name;
+	void (*or_words)(eword_t *dst, const eword_t *src, size_t nr);
+	void (*and_not_words)(eword_t *dst, const eword_t *src, size_t nr);
+	size_t (*popcount_words)(const eword_t *words, size_t nr);
+};
+
+static void or_words_portable(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] |= src[i];
+}
+
+static void and_not_words_portable(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++)
+		dst[i] &= ~src[i];
+}
+
+static size_t popcount_words_portable(const eword_t *words, size_t nr)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < nr; i++)
+		count += ewah_bit_popcount64(words[i]);
+
+	return count;
+}
+
+static const struct word_kernels portable_kernels = {
+	.name = "portable",
+	.or_words = or_words_portable,
+	.and_not_words = and_not_words_portable,
+	.popcount_words = popcount_words_portable,
+};
+
+#ifdef EWAH_AVX2
+__attribute__((target("avx2")))
+static void or_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(a, b));
+	}
+	or_words_portable(dst + i, src + i, nr - i);
+}
+
+__attribute__((target("avx2")))
+static void and_not_words_avx2(eword_t *dst, const eword_t *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), _mm256_andnot_si256(b, a));
+	}
+	and_not_words_portable(dst + i, src + i, nr - i);
+}
+
+/*
+ * Count the bits of each nibble with a table lookup (vpshufb), and sum
+ * the per-byte counts into the four 64-bit lanes (vpsadbw).
+ */
+__attribute__((target("avx2")))
+static size_t popcount_words_avx2(const eword_t *words, size_t nr)
+{
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+					       1, 2, 2, 3, 2, 3, 3, 4,
+					       0, 1, 1, 2, 1, 2, 2, 3,
+					       1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i sum = _mm256_setzero_si256();
+	uint64_t lanes[4];
+	size_t i;
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+		__m256i lo = _mm256_and_si256(v, nibble);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+		__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(table, lo),
+						_mm256_shuffle_epi8(table, hi));
+
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(bytes,
+							    _mm256_setzero_si256()));
+	}
+	_mm256_storeu_si256((__m256i *)lanes, sum);
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+		popcount_words_portable(words + i, nr - i);
+}
+
+static const struct word_kernels avx2_kernels = {
+	.name = "avx2",
+	.or_words = or_words_avx2,
+	.and_not_words = and_not_words_avx2,
+	.popcount_words = popcount_words_avx2,
+};
+#endif
+
+static const struct word_kernels *kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* Pick the fastest kernels this CPU can run. */
+static void select_word_kernels(void)
+{
+	kernels = &portable_kernels;
+#ifdef EWAH_AVX2
+	if (!git_env_bool("GIT_TEST_EWAH_PORTABLE", 0) &&
+	    __builtin_cpu_supports("avx2"))
+		kernels = &avx2_kernels;
+#endif
+}
+
+static const struct word_kernels *word_kernels(void)
+{
+	pthread_once(&kernels_once, select_word_kernels);
+	return kernels;
+}
+
+const char *bitmap_kernels_name(void)
+{
+	return word_kernels()->name;
+}
+
 struct bitmap *bitmap_word_alloc(size_t word_alloc)
 {
 	struct bitmap *bitmap = xmalloc(sizeof(struct bitmap));
@@ -123,19 +271,13 @@ void bitmap_and_not(struct bitmap *self, struct bitmap *other)
 	const size_t count = (self->word_alloc < other->word_alloc) ?
 		self->word_alloc : other->word_alloc;
 
-	size_t i;
-
-	for (i = 0; i < count; ++i)
-		self->words[i] &= ~other->words[i];
+	word_kernels()->and_not_words(self->words, other->words, count);
 }
 
 void bitmap_or(struct bitmap *self, const struct bitmap *other)
 {
-	size_t i;
-
 	bitmap_grow(self, other->word_alloc);
-	for (i = 0; i < other->word_alloc; i++)
-		self->words[i] |= other->words[i];
+	word_kernels()->or_words(self->words, other->words, other->word_alloc);
 }
 
 int ewah_bitmap_is_subset(struct ewah_bitmap *self, struct bitmap *other)
@@ -181,13 +323,19 @@ int ewah_bitmap_is_subset(struct ewah_bitmap *self, struct bitmap *other)
 	return 1;
 }
 
+/*
+ * Rather than going through an ewah_iterator one word at a time, the
+ * two functions below walk the run-length words of the EWAH bitmap
+ * directly, so that a whole run of clean words is handled at once, and
+ * the literal words in between are handed to the word kernels as one
+ * array.
+ */
 void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
 {
+	const struct word_kernels *k = word_kernels();
 	size_t original_size = self->word_alloc;
 	size_t other_final = (other->bit_size / BITS_IN_EWORD) + 1;
-	size_t i = 0;
-	struct ewah_iterator it;
-	eword_t word;
+	size_t i = 0, pos = 0;
 
 	if (self->word_alloc < other_final) {
 		self->word_alloc = other_final;
@@ -196,32 +344,47 @@ void bitmap_or_ewah(struct bitmap *self, struct ewah_bitmap *other)
 			(self->word_alloc - original_size) * sizeof(eword_t));
 	}
 
-	ewah_iterator_init(&it, other);
+	while (pos < other->buffer_size) {
+		const eword_t *rlw = other->buffer + pos++;
+		size_t run = rlw_get_running_len(rlw);
+		size_t literals = rlw_get_literal_words(rlw);
 
-	while (ewah_iterator_next(&word, &it))
-		self->words[i++] |= word;
+		if (literals > other->buffer_size - pos)
+			literals = other->buffer_size - pos;
+		bitmap_grow(self, i + run + literals);
+
+		if (rlw_get_run_bit(rlw))
+			memset(self->words + i, 0xff, run * sizeof(eword_t));
+		i += run;
+
+		k->or_words(self->words + i, other->buffer + pos, literals);
+		i += literals;
+		pos += literals;
+	}
 }
 
 size_t bitmap_popcount(struct bitmap *self)
 {
-	size_t i, count = 0;
-
-	for (i = 0; i < self->word_alloc; ++i)
-		count += ewah_bit_popcount64(self->words[i]);
-
-	return count;
+	return word_kernels()->popcount_words(self->words, self->word_alloc);
 }
 
 size_t ewah_bitmap_popcount(struct ewah_bitmap *self)
 {
-	struct ewah_iterator it;
-	eword_t word;
-	size_t count = 0;
+	const struct word_kernels *k = word_kernels();
+	size_t count = 0, pos = 0;
 
-	ewah_iterator_init(&it, self);
+	while (pos < self->buffer_size) {
+		const eword_t *rlw = self->buffer + pos++;
+		size_t literals = rlw_get_literal_words(rlw);
 
-	while (ewah_iterator_next(&word, &it))
-		count += ewah_bit_popcount64(word);
+		if (literals > self->buffer_size - pos)
+			literals = self->buffer_size - pos;
+		if (rlw_get_run_bit(rlw))
+			count += rlw_get_running_len(rlw) * BITS_IN_EWORD;
+
+		count += k->popcount_words(self->buffer + pos, literals);
+		pos += literals;
+	}
 
 	return count;
 }
@@ -114,6 +114,14 @@ void ewah_each_bit(struct ewah_bitmap *self, ewah_callback callback, void *paylo
  */
 void ewah_set(struct ewah_bitmap *self, size_t i);
 
+/**
+ * Return whether the given bit is set on the bitmap.
+ *
+ * This only walks over the run-length words of the bitmap, and does
+ * not decompress it.
+ */
+int ewah_get(struct ewah_bitmap *self, size_t i);
+
 struct ewah_iterator {
 	const eword_t *buffer;
 	size_t buffer_size;
@@ -199,4 +207,10 @@ size_t bitmap_popcount(struct bitmap *self);
 size_t ewah_bitmap_popcount(struct ewah_bitmap *self);
 int bitmap_is_empty(struct bitmap *self);
 
+/*
+ * The name of the implementation of the loops over the words of
+ * uncompressed bitmaps that was picked for this CPU, e.g. "avx2".
+ */
+const char *bitmap_kernels_name(void);
+
 #endif
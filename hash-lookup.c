@@ -5,11 +5,6 @@
 #include "hash-lookup.h"
 #include "read-cache-ll.h"
 
-static uint32_t take2(const struct object_id *oid, size_t ofs)
-{
-	return ((oid->hash[ofs] << 8) | oid->hash[ofs + 1]);
-}
-
 /*
  * Conventional binary search loop looks like this:
  *
@@ -49,6 +44,95 @@ static uint32_t take2(const struct object_id *oid, size_t ofs)
  * target and lo is much shorter than the target and hi, we could
  * pick mi that is much closer to lo than the midway.
  */
+/*
+ * Object names are uniformly distributed, so instead of always probing
+ * the middle we can guess where the target sits from the four bytes of
+ * its name at "key_ofs" (the bytes before it are shared by the whole
+ * range being searched, e.g. the first byte after a fanout lookup).
+ * Every probe narrows the range from one side, and the next guess is
+ * interpolated between the keys of the entries just outside of it,
+ * which lands within a few entries of the target after two or three
+ * rounds.
+ *
+ * A table whose names are not uniform (or share more than four bytes)
+ * could make interpolation crawl, so after INTERPOLATION_PROBES rounds
+ * we fall back to halving the range, and once the range is no longer
+ * than LINEAR_SCAN_WINDOW entries we walk it, as the entries are next
+ * to each other in memory and comparing them in order is cheaper than
+ * jumping around.
+ */
+#define INTERPOLATION_PROBES 8
+#define LINEAR_SCAN_WINDOW 8
+
+typedef const unsigned char *hash_access_fn(size_t index, const void *table);
+
+static inline int interpolation_search(const unsigned char *hash,
+				       size_t len, size_t key_ofs,
+				       size_t lo, size_t hi,
+				       hash_access_fn fn, const void *table,
+				       size_t *result)
+{
+	uint32_t key = get_be32(hash + key_ofs);
+	uint64_t lokey = 0, hikey = (uint64_t)1 << 32;
+	int probes = 0;
+
+	while (lo + LINEAR_SCAN_WINDOW < hi) {
+		const unsigned char *entry;
+		size_t mi;
+		int cmp;
+
+		if (probes++ < INTERPOLATION_PROBES && lokey < hikey) {
+			/*
+			 * In a sorted table lokey <= key <= hikey, so this
+			 * is at most "hi - lo"; the check only keeps us
+			 * within the range when the table is corrupt.
+			 */
+			uint64_t ofs = (key - lokey) * (hi - lo) / (hikey - lokey);
+			mi = ofs < hi - lo ? lo + ofs : hi - 1;
+		} else {
+			mi = lo + (hi - lo) / 2;
+		}
+
+		entry = fn(mi, table);
+		cmp = memcmp(entry, hash, len);
+		if (!cmp) {
+			*result = mi;
+			return 1;
+		}
+		if (cmp > 0) {
+			hi = mi;
+			hikey = get_be32(entry + key_ofs);
+		} else {
+			lo = mi + 1;
+			lokey = get_be32(entry + key_ofs);
+		}
+	}
+
+	for (; lo < hi; lo++) {
+		int cmp = memcmp(fn(lo, table), hash, len);
+
+		if (!cmp) {
+			*result = lo;
+			return 1;
+		}
+		if (cmp > 0)
+			break;
+	}
+	*result = lo;
+	return 0;
+}
+
+struct oid_table {
+	const void *table;
+	oid_access_fn *fn;
+};
+
+static const unsigned char *oid_table_hash(size_t index, const void *data)
+{
+	const struct oid_table *t = data;
+	return t->fn(index, t->table)->hash;
+}
+
 /*
  * The table should contain "nr" elements.
  * The oid of element i (between 0 and nr - 1) should be returned
@@ -57,78 +141,40 @@ static uint32_t take2(const struct object_id *oid, size_t ofs)
 int oid_pos(const struct object_id *oid, const void *table, size_t nr,
 	    oid_access_fn fn)
 {
-	size_t hi = nr;
-	size_t lo = 0;
-	size_t mi = 0;
-
-	if (!nr)
-		return -1;
-
-	if (nr != 1) {
-		size_t lov, hiv, miv, ofs;
-
-		for (ofs = 0; ofs < the_hash_algo->rawsz - 2; ofs += 2) {
-			lov = take2(fn(0, table), ofs);
-			hiv = take2(fn(nr - 1, table), ofs);
-			miv = take2(oid, ofs);
-			if (miv < lov)
-				return -1;
-			if (hiv < miv)
-				return index_pos_to_insert_pos(nr);
-			if (lov != hiv) {
-				/*
-				 * At this point miv could be equal
-				 * to hiv (but hash could still be higher);
-				 * the invariant of (mi < hi) should be
-				 * kept.
-				 */
-				mi = (nr - 1) * (miv - lov) / (hiv - lov);
-				if (lo <= mi && mi < hi)
-					break;
-				BUG("assertion failed in binary search");
-			}
-		}
-	}
+	struct oid_table t = { table, fn };
+	size_t pos;
 
-	do {
-		int cmp;
-		cmp = oidcmp(fn(mi, table), oid);
-		if (!cmp)
-			return mi;
-		if (cmp > 0)
-			hi = mi;
-		else
-			lo = mi + 1;
-		mi = lo + (hi - lo) / 2;
-	} while (lo < hi);
-	return index_pos_to_insert_pos(lo);
+	if (interpolation_search(oid->hash, GIT_MAX_RAWSZ, 0, 0, nr,
+				 oid_table_hash, &t, &pos))
+		return pos;
+	return index_pos_to_insert_pos(pos);
+}
+
+struct hash_table {
+	const unsigned char *table;
+	size_t stride;
+};
+
+static const unsigned char *hash_table_entry(size_t index, const void *data)
+{
+	const struct hash_table *t = data;
+	return t->table + index * t->stride;
 }
 
 int bsearch_hash(const unsigned char *hash, const uint32_t *fanout_nbo,
 		 const unsigned char *table, size_t stride, uint32_t *result)
 {
+	struct hash_table t = { table, stride };
 	uint32_t hi, lo;
+	size_t pos;
+	int found;
 
 	hi = ntohl(fanout_nbo[*hash]);
 	lo = ((*hash == 0x0) ? 0 : ntohl(fanout_nbo[*hash - 1]));
 
-	while (lo < hi) {
-		unsigned mi = lo + (hi - lo) / 2;
-		int cmp = hashcmp(table + mi * stride, hash,
-				  the_repository->hash_algo);
-
-		if (!cmp) {
-			if (result)
-				*result = mi;
-			return 1;
-		}
-		if (cmp > 0)
-			hi = mi;
-		else
-			lo = mi + 1;
-	}
-
+	found = interpolation_search(hash, the_repository->hash_algo->rawsz, 1,
+				     lo, hi, hash_table_entry, &t, &pos);
 	if (result)
-		*result = lo;
-	return 0;
+		*result = pos;
+	return found;
 }
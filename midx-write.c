@@ -827,20 +827,19 @@ static struct commit **find_commits_for_midx_bitmap(uint32_t *indexed_commits_nr
 	return cb.commits;
 }
 
-static int write_midx_bitmap(const char *midx_name,
+static int write_midx_bitmap(const char *bitmap_name,
 			     const unsigned char *midx_hash,
 			     struct packing_data *pdata,
 			     struct commit **commits,
 			     uint32_t commits_nr,
 			     uint32_t *pack_order,
+			     struct multi_pack_index *base_midx,
 			     unsigned flags)
 {
 	int ret, i;
 	uint16_t options = 0;
 	struct bitmap_writer writer;
 	struct pack_idx_entry **index;
-	char *bitmap_name = xstrfmt("%s-%s.bitmap", midx_name,
-					hash_to_hex(midx_hash));
 
 	trace2_region_enter("midx", "write_midx_bitmap", the_repository);
 
@@ -859,7 +858,7 @@ static int write_midx_bitmap(const char *midx_name,
 	for (i = 0; i < pdata->nr_objects; i++)
 		index[i] = &pdata->objects[i].idx;
 
-	bitmap_writer_init(&writer, the_repository, pdata);
+	bitmap_writer_init(&writer, the_repository, pdata, base_midx);
 	bitmap_writer_show_progress(&writer, flags & MIDX_PROGRESS);
 	bitmap_writer_build_type_index(&writer, index);
 
@@ -889,7 +888,6 @@ static int write_midx_bitmap(const char *midx_name,
 
 cleanup:
 	free(index);
-	free(bitmap_name);
 	bitmap_writer_free(&writer);
 
 	trace2_region_leave("midx", "write_midx_bitmap", the_repository);
@@ -927,12 +925,17 @@ static int fill_packs_from_midx(struct write_midx_context *ctx,
 {
 	struct multi_pack_index *m;
 
+	/*
+	 * Store the packs of each layer at their position in the whole
+	 * chain, since that is how the MIDX's objects refer to them.
+	 */
+	ALLOC_GROW(ctx->info, ctx->m->num_packs + ctx->m->num_packs_in_base,
+		   ctx->alloc);
+
 	for (m = ctx->m; m; m = m->base_midx) {
 		uint32_t i;
 
 		for (i = 0; i < m->num_packs; i++) {
-			ALLOC_GROW(ctx->info, ctx->nr + 1, ctx->alloc);
-
 			/*
 			 * If generating a reverse index, need to have
 			 * packed_git's loaded to compare their
@@ -955,11 +958,12 @@ static int fill_packs_from_midx(struct write_midx_context *ctx,
 					    m->packs[i]->pack_name);
 			}
 
-			fill_pack_info(&ctx->info[ctx->nr++], m->packs[i],
-				       m->pack_names[i],
+			fill_pack_info(&ctx->info[m->num_packs_in_base + i],
+				       m->packs[i], m->pack_names[i],
 				       m->num_packs_in_base + i);
 		}
 	}
+	ctx->nr = ctx->m->num_packs + ctx->m->num_packs_in_base;
 	return 0;
 }
 
@@ -1073,8 +1077,6 @@ static int write_midx_internal(const char *object_dir,
 	trace2_region_enter("midx", "write_midx_internal", the_repository);
 
 	ctx.incremental = !!(flags & MIDX_WRITE_INCREMENTAL);
-	if (ctx.incremental && (flags & MIDX_WRITE_BITMAP))
-		die(_("cannot write incremental MIDX with bitmap"));
 
 	if (ctx.incremental)
 		strbuf_addf(&midx_name,
@@ -1119,6 +1121,23 @@ static int write_midx_internal(const char *object_dir,
 			ctx.num_multi_pack_indexes_before++;
 			m = m->base_midx;
 		}
+
+		if (ctx.base_midx && (flags & MIDX_WRITE_BITMAP)) {
+			/*
+			 * The bitmap of the new layer refers to the objects
+			 * in the existing ones, and only stores bitmaps for
+			 * its own commits, so those layers must have
+			 * bitmaps, too.
+			 */
+			struct bitmap_index *bitmap_git =
+				prepare_midx_bitmap_git(ctx.base_midx);
+			if (!bitmap_git) {
+				warning(_("existing multi-pack-index has no bitmap; "
+					  "not writing one for the new layer"));
+				flags &= ~MIDX_WRITE_BITMAP;
+			}
+			free_bitmap_index(bitmap_git);
+		}
 	} else if (ctx.m && fill_packs_from_midx(&ctx, preferred_pack_name,
 						 flags) < 0) {
 		goto cleanup;
@@ -1138,7 +1157,7 @@ static int write_midx_internal(const char *object_dir,
 	stop_progress(&ctx.progress);
 
 	if ((ctx.m && ctx.nr == ctx.m->num_packs + ctx.m->num_packs_in_base) &&
-	    !ctx.incremental &&
+	    !ctx.incremental && !ctx.m->has_chain &&
 	    !(packs_to_include || packs_to_drop)) {
 		struct bitmap_index *bitmap_git;
 		int bitmap_exists;
@@ -1388,6 +1407,7 @@ static int write_midx_internal(const char *object_dir,
 		struct packing_data pdata;
 		struct commit **commits;
 		uint32_t commits_nr;
+		struct strbuf bitmap_name = STRBUF_INIT;
 
 		if (!ctx.entries_nr)
 			BUG("cannot write a bitmap without any objects");
@@ -1405,15 +1425,24 @@ static int write_midx_internal(const char *object_dir,
 		FREE_AND_NULL(ctx.entries);
 		ctx.entries_nr = 0;
 
-		if (write_midx_bitmap(midx_name.buf, midx_hash, &pdata,
+		if (ctx.incremental)
+			get_split_midx_filename_ext(&bitmap_name, object_dir,
+						    midx_hash, MIDX_EXT_BITMAP);
+		else
+			get_midx_filename_ext(&bitmap_name, object_dir,
+					      midx_hash, MIDX_EXT_BITMAP);
+
+		if (write_midx_bitmap(bitmap_name.buf, midx_hash, &pdata,
 				      commits, commits_nr, ctx.pack_order,
-				      flags) < 0) {
+				      ctx.base_midx, flags) < 0) {
 			error(_("could not write multi-pack bitmap"));
 			result = 1;
 			clear_packing_data(&pdata);
 			free(commits);
+			strbuf_release(&bitmap_name);
 			goto cleanup;
 		}
+		strbuf_release(&bitmap_name);
 
 		clear_packing_data(&pdata);
 		free(commits);
@@ -221,6 +221,15 @@ struct raw_object_store {
 	unsigned long approximate_object_count;
 	unsigned approximate_object_count_valid : 1;
 
+	/*
+	 * A Bloom filter of the objects in the packs that are not covered
+	 * by a multi-pack-index, built once enough lookups missed all of
+	 * them; see find_pack_entry().
+	 */
+	uint64_t *pack_oid_filter;
+	uint32_t pack_oid_filter_words;
+	uint64_t pack_oid_filter_probes;
+
 	/*
 	 * Whether packed_git has already been populated with this repository's
 	 * packs.
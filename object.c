@@ -119,18 +119,13 @@ struct object *lookup_object(struct repository *r, const struct object_id *oid)
 }
 
 /*
- * Increase the size of the hash map stored in obj_hash to the next
- * power of 2 (but at least 32).  Copy the existing values to the new
- * hash map.
+ * Rehash the existing values of obj_hash into a new hash map of
+ * new_hash_size buckets, which must be a power of 2 to match
+ * hash_obj above.
  */
-static void grow_object_hash(struct repository *r)
+static void resize_object_hash(struct repository *r, int new_hash_size)
 {
 	int i;
-	/*
-	 * Note that this size must always be power-of-2 to match hash_obj
-	 * above.
-	 */
-	int new_hash_size = r->parsed_objects->obj_hash_size < 32 ? 32 : 2 * r->parsed_objects->obj_hash_size;
 	struct object **new_hash;
 
 	CALLOC_ARRAY(new_hash, new_hash_size);
@@ -146,6 +141,33 @@ static void grow_object_hash(struct repository *r)
 	r->parsed_objects->obj_hash_size = new_hash_size;
 }
 
+/*
+ * Increase the size of the hash map stored in obj_hash to the next
+ * power of 2 (but at least 32).  Copy the existing values to the new
+ * hash map.
+ */
+static void grow_object_hash(struct repository *r)
+{
+	int size = r->parsed_objects->obj_hash_size;
+
+	resize_object_hash(r, size < 32 ? 32 : 2 * size);
+}
+
+void reserve_object_hash(struct repository *r, unsigned int nr)
+{
+	size_t want = st_add(r->parsed_objects->nr_objs, nr);
+	size_t size = r->parsed_objects->obj_hash_size < 32 ?
+		32 : r->parsed_objects->obj_hash_size;
+
+	/* keep the same load factor that create_object() maintains */
+	while (size - 1 <= st_mult(want, 2))
+		size = st_mult(size, 2);
+	if (size > INT_MAX)
+		return;
+	if (size > r->parsed_objects->obj_hash_size)
+		resize_object_hash(r, size);
+}
+
 void *create_object(struct repository *r, const struct object_id *oid, void *o)
 {
 	struct object *obj = o;
@@ -192,6 +192,14 @@ struct object *lookup_object(struct repository *r, const struct object_id *oid);
 
 void *create_object(struct repository *r, const struct object_id *oid, void *obj);
 
+/*
+ * Grow the object hash up front so that "nr" more objects can be
+ * created without it having to be resized.  Callers that are about to
+ * look at (nearly) every object in the repository can use this to
+ * avoid rehashing the table over and over as it fills up.
+ */
+void reserve_object_hash(struct repository *r, unsigned int nr);
+
 void *object_as_type(struct object *obj, enum object_type type, int quiet);
 
 
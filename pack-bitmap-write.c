@@ -25,6 +25,8 @@
 #include "alloc.h"
 #include "refs.h"
 #include "strmap.h"
+#include "midx.h"
+#include "pack-revindex.h"
 
 struct bitmapped_commit {
 	struct commit *commit;
@@ -41,8 +43,16 @@ static inline int bitmap_writer_nr_selected_commits(struct bitmap_writer *writer
 	return writer->selected_nr - writer->pseudo_merges_nr;
 }
 
+static inline uint32_t bitmap_writer_nr_base_objects(struct bitmap_writer *writer)
+{
+	if (!writer->midx)
+		return 0;
+	return writer->midx->num_objects + writer->midx->num_objects_in_base;
+}
+
 void bitmap_writer_init(struct bitmap_writer *writer, struct repository *r,
-			struct packing_data *pdata)
+			struct packing_data *pdata,
+			struct multi_pack_index *midx)
 {
 	memset(writer, 0, sizeof(struct bitmap_writer));
 	if (writer->bitmaps)
@@ -50,6 +60,7 @@ void bitmap_writer_init(struct bitmap_writer *writer, struct repository *r,
 	writer->bitmaps = kh_init_oid_map();
 	writer->pseudo_merge_commits = kh_init_oid_map();
 	writer->to_pack = pdata;
+	writer->midx = midx;
 
 	string_list_init_dup(&writer->pseudo_merge_groups);
 
@@ -111,6 +122,7 @@ void bitmap_writer_show_progress(struct bitmap_writer *writer, int show)
 void bitmap_writer_build_type_index(struct bitmap_writer *writer,
 				    struct pack_idx_entry **index)
 {
+	uint32_t base_objects = bitmap_writer_nr_base_objects(writer);
 	uint32_t i;
 
 	writer->commits = ewah_new();
@@ -141,19 +153,19 @@ void bitmap_writer_build_type_index(struct bitmap_writer *writer,
 
 		switch (real_type) {
 		case OBJ_COMMIT:
-			ewah_set(writer->commits, i);
+			ewah_set(writer->commits, i + base_objects);
 			break;
 
 		case OBJ_TREE:
-			ewah_set(writer->trees, i);
+			ewah_set(writer->trees, i + base_objects);
 			break;
 
 		case OBJ_BLOB:
-			ewah_set(writer->blobs, i);
+			ewah_set(writer->blobs, i + base_objects);
 			break;
 
 		case OBJ_TAG:
-			ewah_set(writer->tags, i);
+			ewah_set(writer->tags, i + base_objects);
 			break;
 
 		default:
@@ -208,6 +220,17 @@ static uint32_t find_object_pos(struct bitmap_writer *writer,
 {
 	struct object_entry *entry = packlist_find(writer->to_pack, oid);
 
+	if (!entry && writer->midx) {
+		uint32_t at, pos;
+
+		if (bsearch_midx(oid, writer->midx, &at) &&
+		    !midx_to_pack_pos(writer->midx, at, &pos)) {
+			if (found)
+				*found = 1;
+			return pos;
+		}
+	}
+
 	if (!entry) {
 		if (found)
 			*found = 0;
@@ -218,7 +241,8 @@ static uint32_t find_object_pos(struct bitmap_writer *writer,
 
 	if (found)
 		*found = 1;
-	return oe_in_pack_pos(writer->to_pack, entry);
+	return oe_in_pack_pos(writer->to_pack, entry) +
+		bitmap_writer_nr_base_objects(writer);
 }
 
 static void compute_xor_offsets(struct bitmap_writer *writer)
@@ -500,7 +524,7 @@ static int fill_bitmap_commit(struct bitmap_writer *writer,
 		struct commit_list *p;
 		struct commit *c = prio_queue_get(queue);
 
-		if (old_bitmap && mapping) {
+		if (old_bitmap) {
 			struct ewah_bitmap *old;
 			struct bitmap *remapped = bitmap_new();
 
@@ -512,8 +536,14 @@ static int fill_bitmap_commit(struct bitmap_writer *writer,
 			 * If this commit has an old bitmap, then translate that
 			 * bitmap and add its bits to this one. No need to walk
 			 * parents or the tree for this commit.
+			 *
+			 * Without a mapping, the old bitmap is that of the
+			 * MIDX chain we are appending a layer to, and its bits
+			 * need no translating.
 			 */
-			if (old && !rebuild_bitmap(mapping, old, remapped)) {
+			if (old && !mapping)
+				bitmap_or_ewah(remapped, old);
+			if (old && (!mapping || !rebuild_bitmap(mapping, old, remapped))) {
 				bitmap_or(ent->bitmap, remapped);
 				bitmap_free(remapped);
 				if (commit->object.flags & BITMAP_PSEUDO_MERGE)
@@ -594,8 +624,11 @@ int bitmap_writer_build(struct bitmap_writer *writer)
 	trace2_region_enter("pack-bitmap-write", "building_bitmaps_total",
 			    the_repository);
 
-	old_bitmap = prepare_bitmap_git(writer->to_pack->repo);
-	if (old_bitmap)
+	if (writer->midx)
+		old_bitmap = prepare_midx_bitmap_git(writer->midx);
+	else
+		old_bitmap = prepare_bitmap_git(writer->to_pack->repo);
+	if (old_bitmap && !writer->midx)
 		mapping = create_bitmap_mapping(old_bitmap, writer->to_pack);
 	else
 		mapping = NULL;
@@ -1052,7 +1085,8 @@ void bitmap_writer_finish(struct bitmap_writer *writer,
 
 		if (commit_pos < 0)
 			BUG(_("trying to write commit not in index"));
-		stored->commit_pos = commit_pos;
+		stored->commit_pos = commit_pos +
+			bitmap_writer_nr_base_objects(writer);
 	}
 
 	write_selected_commits_v1(writer, f, offsets);
@@ -8,6 +8,8 @@
 #include "string-list.h"
 
 struct commit;
+struct commit_list;
+struct multi_pack_index;
 struct repository;
 struct rev_info;
 
@@ -101,6 +103,22 @@ int bitmap_walk_contains(struct bitmap_index *,
  */
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_id *oid);
 
+/*
+ * Return a bitmap of the commits reachable from "commit" (including
+ * itself), using the bitmaps of the commits found in its history. Return
+ * NULL if some of those commits are not in the bitmapped pack(s), and
+ * thus cannot be represented in the result.
+ */
+struct bitmap *bitmap_reachable_commits(struct bitmap_index *,
+					struct commit *commit);
+
+/*
+ * If "commit" has a bitmap, return 1 if one of the commits in "want" is
+ * reachable from it and 0 if none is. Return -1 if it has no bitmap.
+ */
+int bitmap_commit_reaches_any(struct bitmap_index *, struct commit *commit,
+			      const struct commit_list *want);
+
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
 struct bitmap_writer {
@@ -112,6 +130,14 @@ struct bitmap_writer {
 	kh_oid_map_t *bitmaps;
 	struct packing_data *to_pack;
 
+	/*
+	 * When writing the bitmap of an incremental MIDX layer, the MIDX
+	 * chain which that layer is appended to. The objects in the chain
+	 * keep their bit positions, and those of the objects in "to_pack"
+	 * come after them.
+	 */
+	struct multi_pack_index *midx;
+
 	struct bitmapped_commit *selected;
 	unsigned int selected_nr, selected_alloc;
 
@@ -125,7 +151,8 @@ struct bitmap_writer {
 };
 
 void bitmap_writer_init(struct bitmap_writer *writer, struct repository *r,
-			struct packing_data *pdata);
+			struct packing_data *pdata,
+			struct multi_pack_index *midx);
 void bitmap_writer_show_progress(struct bitmap_writer *writer, int show);
 void bitmap_writer_set_checksum(struct bitmap_writer *writer,
 				const unsigned char *sha1);
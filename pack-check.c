@@ -2,6 +2,7 @@
 
 #include "git-compat-util.h"
 #include "environment.h"
+#include "gettext.h"
 #include "hex.h"
 #include "repository.h"
 #include "pack.h"
@@ -9,6 +10,7 @@
 #include "packfile.h"
 #include "object-file.h"
 #include "object-store-ll.h"
+#include "thread-utils.h"
 
 struct idx_entry {
 	off_t                offset;
@@ -48,11 +50,234 @@ int check_pack_crc(struct packed_git *p, struct pack_window **w_curs,
 	return data_crc != ntohl(*index_crc);
 }
 
+/*
+ * The result of unpacking and hashing one object of the pack, which
+ * can be computed by a worker thread while the caller's verify_fn
+ * and all reporting happen in pack order on the main thread.
+ */
+struct verify_object {
+	struct object_id oid;
+	enum object_type type;
+	unsigned long size;
+	void *data;
+	unsigned crc_mismatch : 1;
+	unsigned data_valid : 1;
+	unsigned signature_mismatch : 1;
+	unsigned done : 1;
+};
+
+struct verify_state {
+	struct repository *r;
+	struct packed_git *p;
+	struct idx_entry *entries;
+	uint32_t nr_objects;
+
+	/*
+	 * Results are kept in a ring of "window" slots; object "i"
+	 * uses slot "i % window" and may only be claimed by a worker
+	 * once object "i - window" has been consumed.
+	 *
+	 * "size" is the total size of the inflated objects in the ring,
+	 * which workers keep under the delta base cache limit by not
+	 * claiming more objects while it is over (unless the ring is
+	 * empty, so that large objects are still verified).
+	 */
+	struct verify_object *objects;
+	uint32_t window;
+	uint32_t next;
+	uint32_t consumed;
+	size_t size;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+
+/*
+ * Check the CRC of the i-th object (in pack order), unpack it and
+ * make sure its contents hash to the name the index gives it.
+ * Errors are only recorded in "obj"; report_object() prints them.
+ */
+static void verify_object(struct verify_state *state,
+			  struct pack_window **w_curs, uint32_t i,
+			  struct verify_object *obj)
+{
+	struct packed_git *p = state->p;
+	struct idx_entry *entries = state->entries;
+	off_t curpos;
+
+	obj_read_lock();
+	if (nth_packed_object_id(&obj->oid, p, entries[i].nr) < 0)
+		BUG("unable to get oid of object %lu from %s",
+		    (unsigned long)entries[i].nr, p->pack_name);
+
+	if (p->index_version > 1) {
+		off_t offset = entries[i].offset;
+		off_t len = entries[i+1].offset - offset;
+		unsigned int nr = entries[i].nr;
+		obj->crc_mismatch = !!check_pack_crc(p, w_curs, offset, len, nr);
+	}
+
+	curpos = entries[i].offset;
+	obj->type = unpack_object_header(p, w_curs, &curpos, &obj->size);
+	unuse_pack(w_curs);
+
+	if (obj->type == OBJ_BLOB && big_file_threshold <= obj->size) {
+		/*
+		 * Let stream_object_signature() check it with
+		 * the streaming interface; no point slurping
+		 * the data in-core only to discard.
+		 */
+		obj->data = NULL;
+		obj->data_valid = 0;
+	} else {
+		obj->data = unpack_entry(state->r, p, entries[i].offset,
+					 &obj->type, &obj->size);
+		obj->data_valid = 1;
+	}
+	obj_read_unlock();
+
+	if (obj->data &&
+	    check_object_signature(state->r, &obj->oid, obj->data,
+				   obj->size, obj->type) < 0)
+		obj->signature_mismatch = 1;
+}
+
+static int report_object(struct verify_state *state, uint32_t i,
+			 struct verify_object *obj, verify_fn fn)
+{
+	struct packed_git *p = state->p;
+	int err = 0;
+
+	if (obj->crc_mismatch)
+		err = error("index CRC mismatch for object %s "
+			    "from %s at offset %"PRIuMAX"",
+			    oid_to_hex(&obj->oid),
+			    p->pack_name, (uintmax_t)state->entries[i].offset);
+
+	/*
+	 * Streaming and the callback may read other objects, so they
+	 * must not run in parallel with the workers' own reads.
+	 */
+	obj_read_lock();
+	if (obj->data_valid && !obj->data)
+		err = error("cannot unpack %s from %s at offset %"PRIuMAX"",
+			    oid_to_hex(&obj->oid), p->pack_name,
+			    (uintmax_t)state->entries[i].offset);
+	else if (obj->signature_mismatch)
+		err = error("packed %s from %s is corrupt",
+			    oid_to_hex(&obj->oid), p->pack_name);
+	else if (!obj->data && stream_object_signature(state->r, &obj->oid) < 0)
+		err = error("packed %s from %s is corrupt",
+			    oid_to_hex(&obj->oid), p->pack_name);
+	else if (fn) {
+		int eaten = 0;
+		err |= fn(&obj->oid, obj->type, obj->size, obj->data, &eaten);
+		if (eaten)
+			obj->data = NULL;
+	}
+	obj_read_unlock();
+
+	free(obj->data);
+	memset(obj, 0, sizeof(*obj));
+	return err;
+}
+
+static void *verify_worker(void *data)
+{
+	struct verify_state *state = data;
+	struct pack_window *w_curs = NULL;
+
+	pthread_mutex_lock(&state->mutex);
+	for (;;) {
+		uint32_t i;
+
+		struct verify_object *obj;
+
+		while (state->next < state->nr_objects &&
+		       (state->next >= state->consumed + state->window ||
+			(state->next > state->consumed &&
+			 state->size > delta_base_cache_limit)))
+			pthread_cond_wait(&state->cond, &state->mutex);
+		if (state->next >= state->nr_objects)
+			break;
+		i = state->next++;
+		pthread_mutex_unlock(&state->mutex);
+
+		obj = &state->objects[i % state->window];
+		verify_object(state, &w_curs, i, obj);
+
+		pthread_mutex_lock(&state->mutex);
+		if (obj->data)
+			state->size += obj->size;
+		obj->done = 1;
+		pthread_cond_broadcast(&state->cond);
+	}
+	pthread_mutex_unlock(&state->mutex);
+
+	obj_read_lock();
+	unuse_pack(&w_curs);
+	obj_read_unlock();
+	return NULL;
+}
+
+static int verify_objects_threaded(struct verify_state *state, verify_fn fn,
+				   struct progress *progress,
+				   uint32_t base_count, int nr_threads)
+{
+	pthread_t *threads;
+	uint32_t i;
+	int t, err = 0;
+
+	state->window = nr_threads * 16;
+	CALLOC_ARRAY(state->objects, state->window);
+	pthread_mutex_init(&state->mutex, NULL);
+	pthread_cond_init(&state->cond, NULL);
+	enable_obj_read_lock();
+
+	ALLOC_ARRAY(threads, nr_threads);
+	for (t = 0; t < nr_threads; t++)
+		if (pthread_create(&threads[t], NULL, verify_worker, state))
+			die(_("unable to create thread"));
+
+	for (i = 0; i < state->nr_objects; i++) {
+		struct verify_object *obj = &state->objects[i % state->window];
+		size_t size;
+
+		pthread_mutex_lock(&state->mutex);
+		while (!obj->done)
+			pthread_cond_wait(&state->cond, &state->mutex);
+		pthread_mutex_unlock(&state->mutex);
+
+		size = obj->data ? obj->size : 0;
+		err |= report_object(state, i, obj, fn);
+
+		pthread_mutex_lock(&state->mutex);
+		state->consumed++;
+		state->size -= size;
+		pthread_cond_broadcast(&state->cond);
+		pthread_mutex_unlock(&state->mutex);
+
+		if (((base_count + i) & 1023) == 0)
+			display_progress(progress, base_count + i);
+	}
+
+	for (t = 0; t < nr_threads; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+
+	disable_obj_read_lock();
+	pthread_cond_destroy(&state->cond);
+	pthread_mutex_destroy(&state->mutex);
+	free(state->objects);
+	return err;
+}
+
 static int verify_packfile(struct repository *r,
 			   struct packed_git *p,
 			   struct pack_window **w_curs,
 			   verify_fn fn,
-			   struct progress *progress, uint32_t base_count)
+			   struct progress *progress, uint32_t base_count,
+			   int nr_threads)
 
 {
 	off_t index_size = p->index_size;
@@ -63,6 +288,10 @@ static int verify_packfile(struct repository *r,
 	uint32_t nr_objects, i;
 	int err = 0;
 	struct idx_entry *entries;
+	struct verify_state state = {
+		.r = r,
+		.p = p,
+	};
 
 	if (!is_pack_valid(p))
 		return error("packfile %s cannot be accessed", p->pack_name);
@@ -103,67 +332,21 @@ static int verify_packfile(struct repository *r,
 	}
 	QSORT(entries, nr_objects, compare_entries);
 
-	for (i = 0; i < nr_objects; i++) {
-		void *data;
-		struct object_id oid;
-		enum object_type type;
-		unsigned long size;
-		off_t curpos;
-		int data_valid;
-
-		if (nth_packed_object_id(&oid, p, entries[i].nr) < 0)
-			BUG("unable to get oid of object %lu from %s",
-			    (unsigned long)entries[i].nr, p->pack_name);
-
-		if (p->index_version > 1) {
-			off_t offset = entries[i].offset;
-			off_t len = entries[i+1].offset - offset;
-			unsigned int nr = entries[i].nr;
-			if (check_pack_crc(p, w_curs, offset, len, nr))
-				err = error("index CRC mismatch for object %s "
-					    "from %s at offset %"PRIuMAX"",
-					    oid_to_hex(&oid),
-					    p->pack_name, (uintmax_t)offset);
-		}
+	state.entries = entries;
+	state.nr_objects = nr_objects;
 
-		curpos = entries[i].offset;
-		type = unpack_object_header(p, w_curs, &curpos, &size);
-		unuse_pack(w_curs);
-
-		if (type == OBJ_BLOB && big_file_threshold <= size) {
-			/*
-			 * Let stream_object_signature() check it with
-			 * the streaming interface; no point slurping
-			 * the data in-core only to discard.
-			 */
-			data = NULL;
-			data_valid = 0;
-		} else {
-			data = unpack_entry(r, p, entries[i].offset, &type, &size);
-			data_valid = 1;
-		}
+	if (HAVE_THREADS && nr_threads > 1 && nr_objects > 1) {
+		err |= verify_objects_threaded(&state, fn, progress,
+					       base_count, nr_threads);
+	} else {
+		for (i = 0; i < nr_objects; i++) {
+			struct verify_object obj = { 0 };
 
-		if (data_valid && !data)
-			err = error("cannot unpack %s from %s at offset %"PRIuMAX"",
-				    oid_to_hex(&oid), p->pack_name,
-				    (uintmax_t)entries[i].offset);
-		else if (data && check_object_signature(r, &oid, data, size,
-							type) < 0)
-			err = error("packed %s from %s is corrupt",
-				    oid_to_hex(&oid), p->pack_name);
-		else if (!data && stream_object_signature(r, &oid) < 0)
-			err = error("packed %s from %s is corrupt",
-				    oid_to_hex(&oid), p->pack_name);
-		else if (fn) {
-			int eaten = 0;
-			err |= fn(&oid, type, size, data, &eaten);
-			if (eaten)
-				data = NULL;
+			verify_object(&state, w_curs, i, &obj);
+			err |= report_object(&state, i, &obj, fn);
+			if (((base_count + i) & 1023) == 0)
+				display_progress(progress, base_count + i);
 		}
-		if (((base_count + i) & 1023) == 0)
-			display_progress(progress, base_count + i);
-		free(data);
-
 	}
 	display_progress(progress, base_count + i);
 	free(entries);
@@ -186,17 +369,21 @@ int verify_pack_index(struct packed_git *p)
 }
 
 int verify_pack(struct repository *r, struct packed_git *p, verify_fn fn,
-		struct progress *progress, uint32_t base_count)
+		struct progress *progress, uint32_t base_count, int nr_threads)
 {
 	int err = 0;
 	struct pack_window *w_curs = NULL;
+	enum pack_access_pattern pattern;
 
 	err |= verify_pack_index(p);
 	if (!p->index_data)
 		return -1;
 
-	err |= verify_packfile(r, p, &w_curs, fn, progress, base_count);
+	pattern = set_pack_access_pattern(r, PACK_ACCESS_SEQUENTIAL);
+	err |= verify_packfile(r, p, &w_curs, fn, progress, base_count,
+			       nr_threads);
 	unuse_pack(&w_curs);
+	set_pack_access_pattern(r, pattern);
 
 	return err;
 }
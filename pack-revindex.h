@@ -124,6 +124,10 @@ off_t pack_pos_to_offset(struct packed_git *p, uint32_t pos);
  * pack_pos_to_midx converts the object at position "pos" within the MIDX
  * pseudo-pack into a MIDX position.
  *
+ * For an incremental MIDX, both positions are relative to the whole
+ * chain, whose pseudo-pack order is that of each of its layers (starting
+ * with the base), one after another.
+ *
  * If the reverse index has not yet been loaded, or the position is out of
  * bounds, this function aborts.
  *
@@ -135,6 +139,9 @@ uint32_t pack_pos_to_midx(struct multi_pack_index *m, uint32_t pos);
  * midx_to_pack_pos converts from the MIDX-relative position at "at" to the
  * corresponding pack position.
  *
+ * As with pack_pos_to_midx, both positions are relative to the whole chain
+ * of an incremental MIDX.
+ *
  * If the reverse index has not yet been loaded, or the position is out of
  * bounds, this function aborts.
  *
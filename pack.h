@@ -87,7 +87,13 @@ typedef int (*verify_fn)(const struct object_id *, enum object_type, unsigned lo
 const char *write_idx_file(const char *index_name, struct pack_idx_entry **objects, int nr_objects, const struct pack_idx_option *, const unsigned char *sha1);
 int check_pack_crc(struct packed_git *p, struct pack_window **w_curs, off_t offset, off_t len, unsigned int nr);
 int verify_pack_index(struct packed_git *);
-int verify_pack(struct repository *, struct packed_git *, verify_fn fn, struct progress *, uint32_t);
+/*
+ * Verify the checksums of the pack and of every object in it, calling
+ * "fn" on each object in pack order.  With nr_threads > 1, objects are
+ * unpacked and hashed by that many threads ahead of the calls to "fn",
+ * which still all happen on the calling thread.
+ */
+int verify_pack(struct repository *, struct packed_git *, verify_fn fn, struct progress *, uint32_t, int nr_threads);
 off_t write_pack_header(struct hashfile *f, uint32_t);
 void fixup_pack_header_footer(int, unsigned char *, const char *, uint32_t, unsigned char *, off_t);
 char *index_pack_lockfile(int fd, int *is_well_formed);
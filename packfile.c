@@ -16,6 +16,7 @@
 #include "object.h"
 #include "tag.h"
 #include "trace.h"
+#include "trace2.h"
 #include "tree-walk.h"
 #include "tree.h"
 #include "object-file.h"
@@ -43,6 +44,7 @@ static unsigned int pack_open_fds;
 static unsigned int pack_max_fds;
 static size_t peak_pack_mapped;
 static size_t pack_mapped;
+static enum pack_access_pattern pack_access_pattern;
 
 #define SZ_FMT PRIuMAX
 static inline uintmax_t sz_fmt(size_t s) { return s; }
@@ -68,6 +70,90 @@ void pack_report(void)
 		sz_fmt(pack_mapped), sz_fmt(peak_pack_mapped));
 }
 
+/*
+ * Whether use_pack() should map each packfile with a single window
+ * spanning all of it. Without mmap() a "window" is a malloc'd copy, and
+ * on 32-bit systems we would run out of address space quickly, so the
+ * option is ignored there.
+ */
+static int map_whole_pack(void)
+{
+#ifdef NO_MMAP
+	return 0;
+#else
+	return packed_git_map_whole && sizeof(void *) >= 8;
+#endif
+}
+
+/*
+ * Tell the kernel how we are going to touch the bytes of a window, so
+ * that it can pick a readahead policy to match. This is only a hint,
+ * and platforms without madvise() simply do not get it.
+ */
+static void advise_pack_window(struct pack_window *win)
+{
+#if !defined(NO_MMAP) && defined(MADV_NORMAL)
+	int advice;
+
+	switch (pack_access_pattern) {
+	case PACK_ACCESS_SEQUENTIAL:
+		advice = MADV_SEQUENTIAL;
+		break;
+	case PACK_ACCESS_RANDOM:
+		advice = MADV_RANDOM;
+		break;
+	default:
+		advice = MADV_NORMAL;
+		break;
+	}
+	madvise(win->base, win->len, advice);
+#endif
+}
+
+/*
+ * Random object lookups bisect the .idx over and over again; ask for it
+ * to be read in as a whole instead of faulting it in a page at a time.
+ */
+static void advise_pack_index(struct packed_git *p)
+{
+#if !defined(NO_MMAP) && defined(MADV_WILLNEED)
+	if (pack_access_pattern == PACK_ACCESS_RANDOM && p->index_data)
+		madvise((void *)p->index_data, p->index_size, MADV_WILLNEED);
+#endif
+}
+
+enum pack_access_pattern set_pack_access_pattern(struct repository *r,
+						 enum pack_access_pattern pattern)
+{
+	enum pack_access_pattern old = pack_access_pattern;
+	struct packed_git *p;
+
+	/*
+	 * With sliding windows, leave the kernel's default readahead alone;
+	 * the hints are only given for whole-pack mappings.
+	 */
+	if (pattern == old || !map_whole_pack())
+		return old;
+
+	pack_access_pattern = pattern;
+	for (p = r->objects->packed_git; p; p = p->next) {
+		struct pack_window *w;
+
+		for (w = p->windows; w; w = w->next)
+			advise_pack_window(w);
+		advise_pack_index(p);
+	}
+	return old;
+}
+
+static void unmap_pack_window(struct pack_window *w)
+{
+	munmap(w->base, w->len);
+	pack_mapped -= w->len;
+	pack_open_windows--;
+	trace2_counter_add(TRACE2_COUNTER_ID_PACK_WINDOW_UNMAPS, 1);
+}
+
 /*
  * Open and mmap the index file at path, perform a couple of
  * consistency checks, then record its information to p.  Return 0 on
@@ -197,6 +283,8 @@ int open_pack_index(struct packed_git *p)
 	idx_name = xstrfmt("%.*s.idx", (int)len, p->pack_name);
 	ret = check_packed_git_idx(idx_name, p);
 	free(idx_name);
+	if (!ret)
+		advise_pack_index(p);
 	return ret;
 }
 
@@ -279,14 +367,12 @@ static int unuse_one_window(struct packed_git *current)
 	for (p = the_repository->objects->packed_git; p; p = p->next)
 		scan_windows(p, &lru_p, &lru_w, &lru_l);
 	if (lru_p) {
-		munmap(lru_w->base, lru_w->len);
-		pack_mapped -= lru_w->len;
+		unmap_pack_window(lru_w);
 		if (lru_l)
 			lru_l->next = lru_w->next;
 		else
 			lru_p->windows = lru_w->next;
 		free(lru_w);
-		pack_open_windows--;
 		return 1;
 	}
 	return 0;
@@ -300,9 +386,7 @@ void close_pack_windows(struct packed_git *p)
 		if (w->inuse_cnt)
 			die("pack '%s' still has open windows to it",
 			    p->pack_name);
-		munmap(w->base, w->len);
-		pack_mapped -= w->len;
-		pack_open_windows--;
+		unmap_pack_window(w);
 		p->windows = w->next;
 		free(w);
 	}
@@ -357,6 +441,14 @@ void close_pack(struct packed_git *p)
 	oidset_clear(&p->bad_objects);
 }
 
+/* Forget the filter find_pack_entry() may have built of the packs. */
+static void clear_pack_oid_filter(struct raw_object_store *o)
+{
+	FREE_AND_NULL(o->pack_oid_filter);
+	o->pack_oid_filter_words = 0;
+	o->pack_oid_filter_probes = 0;
+}
+
 void close_object_store(struct raw_object_store *o)
 {
 	struct packed_git *p;
@@ -373,6 +465,7 @@ void close_object_store(struct raw_object_store *o)
 	}
 
 	close_commit_graph(o);
+	clear_pack_oid_filter(o);
 }
 
 void unlink_pack_path(const char *pack_name, int force_delete)
@@ -655,11 +748,16 @@ unsigned char *use_pack(struct packed_git *p,
 				die("packfile %s cannot be accessed", p->pack_name);
 
 			CALLOC_ARRAY(win, 1);
-			win->offset = (offset / window_align) * window_align;
-			len = p->pack_size - win->offset;
-			if (len > packed_git_window_size)
-				len = packed_git_window_size;
-			win->len = (size_t)len;
+			if (map_whole_pack()) {
+				win->offset = 0;
+				win->len = xsize_t(p->pack_size);
+			} else {
+				win->offset = (offset / window_align) * window_align;
+				len = p->pack_size - win->offset;
+				if (len > packed_git_window_size)
+					len = packed_git_window_size;
+				win->len = (size_t)len;
+			}
 			pack_mapped += win->len;
 			while (packed_git_limit < pack_mapped
 				&& unuse_one_window(p))
@@ -673,8 +771,11 @@ unsigned char *use_pack(struct packed_git *p,
 			if (!win->offset && win->len == p->pack_size
 				&& !p->do_not_close)
 				close_pack_fd(p);
+			if (pack_access_pattern != PACK_ACCESS_DEFAULT)
+				advise_pack_window(win);
 			pack_mmap_calls++;
 			pack_open_windows++;
+			trace2_counter_add(TRACE2_COUNTER_ID_PACK_WINDOW_MAPS, 1);
 			if (pack_mapped > peak_pack_mapped)
 				peak_pack_mapped = pack_mapped;
 			if (pack_open_windows > peak_pack_open_windows)
@@ -762,6 +863,9 @@ void install_packed_git(struct repository *r, struct packed_git *pack)
 	pack->next = r->objects->packed_git;
 	r->objects->packed_git = pack;
 
+	/* the filter does not know about the objects in the new pack */
+	clear_pack_oid_filter(r->objects);
+
 	hashmap_entry_init(&pack->packmap_ent, strhash(pack->pack_name));
 	hashmap_add(&r->objects->pack_map, &pack->packmap_ent);
 }
@@ -1461,8 +1565,12 @@ static void *cache_or_unpack_entry(struct repository *r, struct packed_git *p,
 	struct delta_base_cache_entry *ent;
 
 	ent = get_delta_base_cache_entry(p, base_offset);
-	if (!ent)
+	if (!ent) {
+		/* unpack_entry() looks it up again, and counts the miss */
 		return unpack_entry(r, p, base_offset, type, base_size);
+	}
+	trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_LOOKUPS, 1);
+	trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HITS, 1);
 
 	if (type)
 		*type = ent->type;
@@ -1511,6 +1619,7 @@ static void add_delta_base_cache(struct packed_git *p, off_t base_offset,
 		if (delta_base_cached <= delta_base_cache_limit)
 			break;
 		release_delta_base_cache(f);
+		trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICTIONS, 1);
 	}
 
 	ent = xmalloc(sizeof(*ent));
@@ -1698,8 +1807,10 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 		int i;
 		struct delta_base_cache_entry *ent;
 
+		trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_LOOKUPS, 1);
 		ent = get_delta_base_cache_entry(p, curpos);
 		if (ent) {
+			trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HITS, 1);
 			type = ent->type;
 			data = ent->data;
 			size = ent->size;
@@ -1707,6 +1818,7 @@ void *unpack_entry(struct repository *r, struct packed_git *p, off_t obj_offset,
 			base_from_cache = 1;
 			break;
 		}
+		trace2_counter_add(TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISSES, 1);
 
 		if (do_check_packed_object_crc && p->index_version > 1) {
 			uint32_t pack_pos, index_pos;
@@ -2051,10 +2163,93 @@ static int fill_pack_entry(const struct object_id *oid,
 	return 1;
 }
 
+/*
+ * Looking up an object that is in none of the packs means searching the
+ * .idx of every one of them, which adds up in a repository with many packs
+ * and no multi-pack-index. Once such searches have cost more than one
+ * pack probe for every PACK_OID_FILTER_PROBE_RATIO objects in those packs,
+ * so that a single pass over their indexes is cheap in comparison, we
+ * build a Bloom filter of all their objects to turn most of these lookups
+ * away after a single memory access.
+ *
+ * Object names are uniformly distributed already, so their bits are used
+ * as the hashes directly. The filter is "blocked": all the bits for an
+ * object live in the same 64-bit word. With 16 bits per object and 3 of
+ * them set for each, it lets through well under 1% of missing objects.
+ */
+#define PACK_OID_FILTER_PROBE_RATIO 8
+#define PACK_OID_FILTER_BITS_PER_OBJECT 16
+
+static uint64_t pack_oid_filter_mask(const unsigned char *hash)
+{
+	/* skip the first bytes; the fanout tables have used them already */
+	uint32_t h = get_be32(hash + 8);
+
+	return ((uint64_t)1 << (h & 63)) |
+	       ((uint64_t)1 << ((h >> 6) & 63)) |
+	       ((uint64_t)1 << ((h >> 12) & 63));
+}
+
+static uint64_t *pack_oid_filter_word(struct raw_object_store *o,
+				      const unsigned char *hash)
+{
+	uint32_t h = get_be32(hash + 4);
+
+	return &o->pack_oid_filter[((uint64_t)h * o->pack_oid_filter_words) >> 32];
+}
+
+static void build_pack_oid_filter(struct raw_object_store *o,
+				  uint64_t nr_objects)
+{
+	uint64_t nr_words = DIV_ROUND_UP(nr_objects *
+					 PACK_OID_FILTER_BITS_PER_OBJECT, 64);
+	struct packed_git *p;
+
+	if (!nr_words || nr_words > UINT32_MAX)
+		return;
+	o->pack_oid_filter_words = nr_words;
+	CALLOC_ARRAY(o->pack_oid_filter, nr_words);
+
+	for (p = o->packed_git; p; p = p->next) {
+		uint32_t i;
+
+		if (p->multi_pack_index)
+			continue;
+		/*
+		 * A pack we cannot read now might be readable later, and a
+		 * filter without its objects would then hide them.
+		 */
+		if (open_pack_index(p)) {
+			clear_pack_oid_filter(o);
+			return;
+		}
+		for (i = 0; i < p->num_objects; i++) {
+			struct object_id oid;
+
+			nth_packed_object_id(&oid, p, i);
+			*pack_oid_filter_word(o, oid.hash) |=
+				pack_oid_filter_mask(oid.hash);
+		}
+	}
+	trace2_counter_add(TRACE2_COUNTER_ID_PACK_OID_FILTER_BUILT, 1);
+}
+
+static int pack_oid_filter_excludes(struct raw_object_store *o,
+				    const struct object_id *oid)
+{
+	uint64_t mask = pack_oid_filter_mask(oid->hash);
+
+	if ((*pack_oid_filter_word(o, oid->hash) & mask) == mask)
+		return 0;
+	trace2_counter_add(TRACE2_COUNTER_ID_PACK_OID_FILTER_SKIPS, 1);
+	return 1;
+}
+
 int find_pack_entry(struct repository *r, const struct object_id *oid, struct pack_entry *e)
 {
 	struct list_head *pos;
 	struct multi_pack_index *m;
+	uint64_t nr_objects = 0, nr_packs = 0;
 
 	prepare_packed_git(r);
 	if (!r->objects->packed_git && !r->objects->multi_pack_index)
@@ -2065,16 +2260,57 @@ int find_pack_entry(struct repository *r, const struct object_id *oid, struct pa
 			return 1;
 	}
 
+	if (r->objects->pack_oid_filter &&
+	    pack_oid_filter_excludes(r->objects, oid))
+		return 0;
+
 	list_for_each(pos, &r->objects->packed_git_mru) {
 		struct packed_git *p = list_entry(pos, struct packed_git, mru);
-		if (!p->multi_pack_index && fill_pack_entry(oid, e, p)) {
+		if (p->multi_pack_index)
+			continue;
+		if (fill_pack_entry(oid, e, p)) {
 			list_move(&p->mru, &r->objects->packed_git_mru);
 			return 1;
 		}
+		nr_objects += p->num_objects;
+		nr_packs++;
+	}
+
+	if (!r->objects->pack_oid_filter) {
+		r->objects->pack_oid_filter_probes += nr_packs;
+		if (r->objects->pack_oid_filter_probes * PACK_OID_FILTER_PROBE_RATIO > nr_objects)
+			build_pack_oid_filter(r->objects, nr_objects);
 	}
 	return 0;
 }
 
+void prefetch_packed_object(struct repository *r, const struct object_id *oid)
+{
+#if !defined(NO_MMAP) && defined(MADV_WILLNEED)
+	struct pack_entry e;
+	struct pack_window *w_curs = NULL;
+	uint32_t pos;
+	off_t end;
+	size_t page_mask = getpagesize() - 1, start;
+	unsigned long left;
+
+	if (!find_pack_entry(r, oid, &e))
+		return;
+	if (offset_to_pack_pos(e.p, e.offset, &pos) < 0)
+		return;
+	end = pack_pos_to_offset(e.p, pos + 1);
+
+	use_pack(e.p, &w_curs, e.offset, &left);
+	/* madvise() wants a page-aligned start, and windows are aligned */
+	start = xsize_t(e.offset - w_curs->offset) & ~page_mask;
+	if (end - e.offset < left)
+		left = end - e.offset;
+	left += xsize_t(e.offset - w_curs->offset) - start;
+	madvise(w_curs->base + start, left, MADV_WILLNEED);
+	unuse_pack(&w_curs);
+#endif
+}
+
 static void maybe_invalidate_kept_pack_cache(struct repository *r,
 					     unsigned flags)
 {
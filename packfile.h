@@ -108,6 +108,28 @@ uint32_t get_pack_fanout(struct packed_git *p, uint32_t value);
 struct raw_object_store;
 
 unsigned char *use_pack(struct packed_git *, struct pack_window **, off_t, unsigned long *);
+
+/*
+ * How the caller is about to access the contents of the packfiles; used
+ * to give the kernel readahead hints for the mapped pack windows.
+ */
+enum pack_access_pattern {
+	PACK_ACCESS_DEFAULT = 0,
+	/* objects are read roughly in pack order, e.g. when verifying */
+	PACK_ACCESS_SEQUENTIAL,
+	/* objects are looked up one by one in no particular order */
+	PACK_ACCESS_RANDOM,
+};
+
+/*
+ * Set the access pattern for all packfiles, including the windows that
+ * are already mapped, and return the previous one so that the caller
+ * can restore it. This is a no-op unless core.packedGitMapWhole is in
+ * effect.
+ */
+enum pack_access_pattern set_pack_access_pattern(struct repository *r,
+						 enum pack_access_pattern pattern);
+
 void close_pack_windows(struct packed_git *);
 void close_pack(struct packed_git *);
 void close_object_store(struct raw_object_store *o);
@@ -188,6 +210,14 @@ const struct packed_git *has_packed_and_bad(struct repository *, const struct ob
  * return true and store its location to e.
  */
 int find_pack_entry(struct repository *r, const struct object_id *oid, struct pack_entry *e);
+
+/*
+ * If "oid" is found in a pack, ask the operating system to start reading
+ * its bytes in the background, so that looking it up again shortly does
+ * not have to wait for the disk. A no-op where this is not supported.
+ */
+void prefetch_packed_object(struct repository *r, const struct object_id *oid);
+
 int find_kept_pack_entry(struct repository *r, const struct object_id *oid, unsigned flags, struct pack_entry *e);
 
 int has_object_pack(const struct object_id *oid);
@@ -13,6 +13,7 @@
 #include "object-name.h"
 #include "object-store-ll.h"
 #include "oid-array.h"
+#include "pack-bitmap.h"
 #include "repo-settings.h"
 #include "repository.h"
 #include "commit.h"
@@ -3174,6 +3175,9 @@ static int do_filter_refs(struct ref_filter *filter, unsigned int type, each_ref
 
 	init_contains_cache(&filter->internal.contains_cache);
 	init_contains_cache(&filter->internal.no_contains_cache);
+	if (filter->with_commit || filter->no_commit)
+		filter->internal.bitmap_git =
+			prepare_reachability_bitmap(the_repository);
 
 	/*  Simple per-ref filtering */
 	if (!filter->kind)
@@ -3212,6 +3216,8 @@ static int do_filter_refs(struct ref_filter *filter, unsigned int type, each_ref
 
 	clear_contains_cache(&filter->internal.contains_cache);
 	clear_contains_cache(&filter->internal.no_contains_cache);
+	free_bitmap_index(filter->internal.bitmap_git);
+	filter->internal.bitmap_git = NULL;
 
 	return ret;
 }
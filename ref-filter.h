@@ -28,6 +28,7 @@
 				    FILTER_REFS_PSEUDOREFS | FILTER_REFS_ROOT_REFS)
 
 struct atom_value;
+struct bitmap_index;
 struct ref_sorting;
 struct ahead_behind_count;
 struct option;
@@ -83,6 +84,7 @@ struct ref_filter {
 	struct {
 		struct contains_cache contains_cache;
 		struct contains_cache no_contains_cache;
+		struct bitmap_index *bitmap_git;
 	} internal;
 };
 
@@ -1,13 +1,40 @@
 #include "git-compat-util.h"
+#include "parse.h"
+#include "thread-utils.h"
 #include "./sha256.h"
 
+/*
+ * Most x86 CPUs made since 2017 have instructions that compute SHA-256
+ * rounds (the "SHA extensions"), which are several times faster than
+ * the portable code below. We compile them in whenever the compiler can
+ * target them on a per-function basis, and use them only if the CPU we
+ * run on turns out to support them.
+ */
+#if !defined(NO_SHA256_SHANI) && (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || GIT_GNUC_PREREQ(4, 9))
+#define SHA256_SHANI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #undef RND
 #undef BLKSIZE
 
 #define BLKSIZE blk_SHA256_BLKSIZE
 
+typedef void (*blocks_fn)(uint32_t *state, const unsigned char *buf,
+			  size_t nr);
+
+static blocks_fn blk_SHA256_Blocks;
+static const char *blk_SHA256_Name;
+
+static pthread_once_t blocks_fn_once = PTHREAD_ONCE_INIT;
+static void select_blocks_fn(void);
+
 void blk_SHA256_Init(blk_SHA256_CTX *ctx)
 {
+	pthread_once(&blocks_fn_once, select_blocks_fn);
+
 	ctx->offset = 0;
 	ctx->size = 0;
 	ctx->state[0] = 0x6a09e667ul;
@@ -55,7 +82,7 @@ static inline uint32_t gamma1(uint32_t x)
 	return ror(x, 17) ^ ror(x, 19) ^ (x >> 10);
 }
 
-static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
+static void blk_SHA256_Transform(uint32_t *state, const unsigned char *buf)
 {
 
 	uint32_t S[8], W[64], t0, t1;
@@ -63,7 +90,7 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 
 	/* copy state into S */
 	for (i = 0; i < 8; i++)
-		S[i] = ctx->state[i];
+		S[i] = state[i];
 
 	/* copy the state into 512-bits into W[0..15] */
 	for (i = 0; i < 16; i++, buf += sizeof(uint32_t))
@@ -145,7 +172,125 @@ static void blk_SHA256_Transform(blk_SHA256_CTX *ctx, const unsigned char *buf)
 	RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],63,0xc67178f2);
 
 	for (i = 0; i < 8; i++)
-		ctx->state[i] += S[i];
+		state[i] += S[i];
+}
+
+static void blk_SHA256_Blocks_portable(uint32_t *state,
+				       const unsigned char *buf, size_t nr)
+{
+	for (; nr; nr--, buf += BLKSIZE)
+		blk_SHA256_Transform(state, buf);
+}
+
+#ifdef SHA256_SHANI
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * sha256rnds2 does two rounds, taking the state as the "ABEF" and
+ * "CDGH" halves, and the message words with the round constants
+ * already added; sha256msg1 and sha256msg2 compute the message
+ * schedule four words at a time, from the previous sixteen.
+ */
+__attribute__((target("sha,sse4.1")))
+static void blk_SHA256_Blocks_shani(uint32_t *state,
+				    const unsigned char *buf, size_t nr)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i abef, cdgh, tmp;
+	int i;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; nr; nr--, buf += BLKSIZE) {
+		__m128i abef_save = abef, cdgh_save = cdgh, w[4];
+
+		for (i = 0; i < 4; i++)
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + 16 * i)),
+						bswap);
+
+		for (i = 0; i < 16; i++) {
+			if (i >= 4) {
+				tmp = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+				tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(i + 3) & 3],
+									 w[(i + 2) & 3], 4));
+				w[i & 3] = _mm_sha256msg2_epu32(tmp, w[(i + 3) & 3]);
+			}
+			tmp = _mm_add_epi32(w[i & 3],
+					    _mm_loadu_si128((const __m128i *)&K[4 * i]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, tmp);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh,
+						     _mm_shuffle_epi32(tmp, 0x0e));
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+static int have_shani(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid(1, eax, ebx, ecx, edx);
+	if (!(ecx & bit_SSE4_1))
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return !!(ebx & bit_SHA);
+}
+#endif
+
+/*
+ * Pick the fastest code this CPU can run. Finding out can be slow
+ * (cpuid traps into the hypervisor in a virtual machine), so we do it
+ * only once.
+ */
+static void select_blocks_fn(void)
+{
+	const char *name = "portable";
+	blocks_fn fn = blk_SHA256_Blocks_portable;
+
+#ifdef SHA256_SHANI
+	if (!git_env_bool("GIT_TEST_SHA256_PORTABLE", 0) && have_shani()) {
+		name = "shani";
+		fn = blk_SHA256_Blocks_shani;
+	}
+#endif
+	blk_SHA256_Name = name;
+	blk_SHA256_Blocks = fn;
+}
+
+const char *blk_SHA256_Impl(void)
+{
+	pthread_once(&blocks_fn_once, select_blocks_fn);
+	return blk_SHA256_Name;
 }
 
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
@@ -165,12 +310,14 @@ void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len)
 		data = ((const char *)data + left);
 		if (len_buf)
 			return;
-		blk_SHA256_Transform(ctx, ctx->buf);
+		blk_SHA256_Blocks(ctx->state, ctx->buf, 1);
 	}
-	while (len >= 64) {
-		blk_SHA256_Transform(ctx, data);
-		data = ((const char *)data + 64);
-		len -= 64;
+	if (len >= 64) {
+		size_t nr = len / 64;
+
+		blk_SHA256_Blocks(ctx->state, data, nr);
+		data = ((const char *)data + nr * 64);
+		len -= nr * 64;
 	}
 	if (len)
 		memcpy(ctx->buf, data, len);
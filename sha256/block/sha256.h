@@ -16,6 +16,11 @@ void blk_SHA256_Init(blk_SHA256_CTX *ctx);
 void blk_SHA256_Update(blk_SHA256_CTX *ctx, const void *data, size_t len);
 void blk_SHA256_Final(unsigned char *digest, blk_SHA256_CTX *ctx);
 
+/*
+ * Name the code blk_SHA256_Update() uses on this CPU, e.g. "portable".
+ */
+const char *blk_SHA256_Impl(void);
+
 #define platform_SHA256_CTX blk_SHA256_CTX
 #define platform_SHA256_Init blk_SHA256_Init
 #define platform_SHA256_Update blk_SHA256_Update
@@ -22,6 +22,8 @@ typedef int (*close_istream_fn)(struct git_istream *);
 typedef ssize_t (*read_istream_fn)(struct git_istream *, char *, size_t);
 
 #define FILTER_BUFFER (1024*16)
+#define SPARSE_STREAM_BUFFER (1024*16)
+#define STREAM_BUFFER (1024*64)
 
 struct filtered_istream {
 	struct git_istream *upstream;
@@ -503,6 +505,13 @@ int stream_blob_to_fd(int fd, const struct object_id *oid, struct stream_filter
 	unsigned long sz;
 	ssize_t kept = 0;
 	int result = -1;
+	/*
+	 * Holes are looked for one buffer at a time, so keep that small
+	 * when we can seek; otherwise use larger writes, which fill a
+	 * whole pipe buffer at once.
+	 */
+	size_t bufsz = can_seek ? SPARSE_STREAM_BUFFER : STREAM_BUFFER;
+	char *buf = NULL;
 
 	st = open_istream(the_repository, oid, &type, &sz, filter);
 	if (!st) {
@@ -512,16 +521,23 @@ int stream_blob_to_fd(int fd, const struct object_id *oid, struct stream_filter
 	}
 	if (type != OBJ_BLOB)
 		goto close_and_exit;
+	if (!can_seek && st->read == read_istream_incore) {
+		/* the whole object is in memory already; do not copy it */
+		if (write_in_full(fd, st->u.incore.buf, st->size) < 0)
+			goto close_and_exit;
+		result = 0;
+		goto close_and_exit;
+	}
+	buf = xmalloc(bufsz);
 	for (;;) {
-		char buf[1024 * 16];
 		ssize_t wrote, holeto;
-		ssize_t readlen = read_istream(st, buf, sizeof(buf));
+		ssize_t readlen = read_istream(st, buf, bufsz);
 
 		if (readlen < 0)
 			goto close_and_exit;
 		if (!readlen)
 			break;
-		if (can_seek && sizeof(buf) == readlen) {
+		if (can_seek && bufsz == readlen) {
 			for (holeto = 0; holeto < readlen; holeto++)
 				if (buf[holeto])
 					break;
@@ -546,6 +562,7 @@ int stream_blob_to_fd(int fd, const struct object_id *oid, struct stream_filter
 	result = 0;
 
  close_and_exit:
+	free(buf);
 	close_istream(st);
 	return result;
 }
@@ -0,0 +1,114 @@
+#include "test-tool.h"
+#include "ewah/ewok.h"
+#include "parse-options.h"
+#include "trace.h"
+
+#define NUM_SECONDS 3
+
+static const char *const bitmap_speed_usage[] = {
+	"test-tool bitmap-speed [--bits=<n>] [--density=<percent>]",
+	NULL
+};
+
+static uint64_t rand_state = 0x9e3779b97f4a7c15;
+
+static uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+/*
+ * Make up a bitmap of "nr" bits, about "density" percent of which are
+ * set. Like the bitmaps of a pack, the bits come in clusters: runs of
+ * words that are all set or all clear, with random words in between.
+ */
+static struct bitmap *make_bitmap(size_t nr, int density)
+{
+	size_t words = DIV_ROUND_UP(nr, BITS_IN_EWORD), i = 0;
+	struct bitmap *bitmap = bitmap_word_alloc(words);
+
+	while (i < words) {
+		size_t len = 1 + next_rand() % 64;
+		int kind = next_rand() % 100;
+
+		for (; len && i < words; len--, i++) {
+			if (kind < density / 2)
+				bitmap->words[i] = (eword_t)~0;
+			else if (kind < density * 3 / 2)
+				bitmap->words[i] = next_rand() & next_rand();
+			else
+				bitmap->words[i] = 0;
+		}
+	}
+	return bitmap;
+}
+
+static void report(const char *what, unsigned long iters, size_t words,
+		   clock_t start, clock_t end)
+{
+	double secs = ((double)end - start) / CLOCKS_PER_SEC;
+
+	printf("%s: %lu iters; %0.2f Gwords/s\n", what, iters,
+	       iters * (double)words / secs / 1e9);
+}
+
+#define TIME(what, words, expr) do { \
+	unsigned long j; \
+	start = end = clock() - initial; \
+	for (j = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) { \
+		expr; \
+		end = clock() - initial; \
+	} \
+	report(what, j, words, start, end); \
+} while (0)
+
+int cmd__bitmap_speed(int argc, const char **argv)
+{
+	unsigned long bits = 10000000;
+	int density = 30;
+	struct bitmap *a, *b, *dst;
+	struct ewah_bitmap *ewah;
+	size_t words, count = 0;
+	clock_t initial, start, end;
+	struct option options[] = {
+		OPT_MAGNITUDE(0, "bits", &bits, "number of bits in the bitmaps"),
+		OPT_INTEGER(0, "density", &density,
+			    "rough percentage of bits that are set"),
+		OPT_END()
+	};
+
+	argc = parse_options(argc, argv, NULL, options, bitmap_speed_usage, 0);
+	if (argc || !bits || density < 0 || density > 100)
+		usage_with_options(bitmap_speed_usage, options);
+
+	words = DIV_ROUND_UP(bits, BITS_IN_EWORD);
+	a = make_bitmap(bits, density);
+	b = make_bitmap(bits, density);
+	dst = bitmap_dup(a);
+	ewah = bitmap_to_ewah(b);
+
+	printf("implementation: %s\n", bitmap_kernels_name());
+	printf("bits: %lu; compressed words: %"PRIuMAX"\n", bits,
+	       (uintmax_t)ewah->buffer_size);
+
+	/* Use this as an offset to make overflow less likely. */
+	initial = clock();
+
+	TIME("or", words, bitmap_or(dst, b));
+	TIME("and-not", words, bitmap_and_not(dst, b));
+	TIME("popcount", words, count += bitmap_popcount(a));
+	TIME("or-ewah", words, bitmap_or_ewah(dst, ewah));
+	TIME("ewah-popcount", words, count += ewah_bitmap_popcount(ewah));
+
+	/* Make sure the compiler cannot optimize the loops away. */
+	trace_printf("count: %"PRIuMAX"\n", (uintmax_t)count);
+
+	ewah_free(ewah);
+	bitmap_free(dst);
+	bitmap_free(b);
+	bitmap_free(a);
+	return 0;
+}
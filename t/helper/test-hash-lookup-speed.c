@@ -0,0 +1,134 @@
+#define USE_THE_REPOSITORY_VARIABLE
+
+#include "test-tool.h"
+#include "hash.h"
+#include "hash-lookup.h"
+#include "parse-options.h"
+#include "repository.h"
+#include "trace.h"
+
+#define NUM_SECONDS 3
+
+static const char *const hash_lookup_speed_usage[] = {
+	"test-tool hash-lookup-speed [--objects=<n>] [--hash=<algo>]",
+	NULL
+};
+
+static uint64_t rand_state = 0x9e3779b97f4a7c15;
+
+static uint64_t next_rand(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+	return rand_state;
+}
+
+static void fill_rand(unsigned char *buf, size_t len)
+{
+	while (len) {
+		uint64_t r = next_rand();
+		size_t n = len < sizeof(r) ? len : sizeof(r);
+
+		memcpy(buf, &r, n);
+		buf += n;
+		len -= n;
+	}
+}
+
+/*
+ * Make up a sorted table of "nr" object names the way an .idx file
+ * stores them, with its fanout. Rather than sorting random names, which
+ * takes a while for a large table, we cut the range of names into "nr"
+ * slices and pick a random name within each of them.
+ */
+static unsigned char *make_table(size_t nr, uint32_t *fanout)
+{
+	size_t rawsz = the_hash_algo->rawsz;
+	uint64_t slice = UINT64_MAX / nr;
+	unsigned char *table = xmalloc(st_mult(nr, rawsz));
+	uint32_t count[256] = { 0 };
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		unsigned char *name = table + i * rawsz;
+
+		put_be64(name, (uint64_t)i * slice + next_rand() % slice);
+		fill_rand(name + 8, rawsz - 8);
+		count[*name]++;
+	}
+	for (i = 0; i < 256; i++) {
+		if (i)
+			count[i] += count[i - 1];
+		fanout[i] = htonl(count[i]);
+	}
+	return table;
+}
+
+static void report(const char *what, unsigned long nr,
+		   clock_t start, clock_t end)
+{
+	double secs = ((double)end - start) / CLOCKS_PER_SEC;
+
+	printf("%s: %lu lookups; %0.2f Mlookups/s\n", what, nr,
+	       nr / secs / 1e6);
+}
+
+int cmd__hash_lookup_speed(int argc, const char **argv)
+{
+	unsigned long objects = 100000000, j, found = 0;
+	const char *hash_name = "sha1";
+	size_t rawsz;
+	int algo;
+	unsigned char missing[GIT_MAX_RAWSZ];
+	uint32_t fanout[256], pos;
+	clock_t initial, start, end;
+	unsigned char *table;
+	struct option options[] = {
+		OPT_MAGNITUDE(0, "objects", &objects,
+			      "number of object names in the table"),
+		OPT_STRING(0, "hash", &hash_name, "algo",
+			   "hash algorithm of the object names"),
+		OPT_END()
+	};
+
+	argc = parse_options(argc, argv, NULL, options,
+			     hash_lookup_speed_usage, 0);
+	if (argc || !objects || objects > UINT32_MAX)
+		usage_with_options(hash_lookup_speed_usage, options);
+	algo = hash_algo_by_name(hash_name);
+	if (algo == GIT_HASH_UNKNOWN)
+		die("unknown hash algorithm '%s'", hash_name);
+	repo_set_hash_algo(the_repository, algo);
+	rawsz = the_hash_algo->rawsz;
+
+	table = make_table(objects, fanout);
+
+	/* Use this as an offset to make overflow less likely. */
+	initial = clock();
+
+	start = end = clock() - initial;
+	for (j = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+		const unsigned char *hash = table + (next_rand() % objects) * rawsz;
+
+		found += bsearch_hash(hash, fanout, table, rawsz, &pos);
+		if (!(j & 1023))
+			end = clock() - initial;
+	}
+	report("existing", j, start, end);
+
+	start = end = clock() - initial;
+	for (j = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+		fill_rand(missing, rawsz);
+		found += bsearch_hash(missing, fanout, table, rawsz, &pos);
+		if (!(j & 1023))
+			end = clock() - initial;
+	}
+	report("missing", j, start, end);
+
+	/* Make sure the compiler cannot optimize the loops away. */
+	trace_printf("found: %lu\n", found);
+
+	free(table);
+	return 0;
+}
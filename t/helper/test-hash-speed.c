@@ -35,6 +35,10 @@ int cmd__hash_speed(int ac, const char **av)
 	initial = clock();
 
 	printf("algo: %s\n", algo->name);
+#ifdef SHA256_BLK
+	if (hash_algo_by_ptr(algo) == GIT_HASH_SHA256)
+		printf("implementation: %s\n", blk_SHA256_Impl());
+#endif
 
 	for (i = 0; i < ARRAY_SIZE(bufsizes); i++) {
 		unsigned long j, kb;
@@ -6,6 +6,7 @@
 #include "gettext.h"
 #include "hex.h"
 #include "object-name.h"
+#include "pack-bitmap.h"
 #include "ref-filter.h"
 #include "setup.h"
 #include "string-list.h"
@@ -151,8 +152,10 @@ int cmd__reach(int ac, const char **av)
 			filter.with_commit_tag_algo = 1;
 		else
 			filter.with_commit_tag_algo = 0;
+		filter.internal.bitmap_git = prepare_reachability_bitmap(r);
 
 		printf("%s(_,A,X,_):%d\n", av[1], commit_contains(&filter, A, X, &cache));
+		free_bitmap_index(filter.internal.bitmap_git);
 	} else if (!strcmp(av[1], "get_reachable_subset")) {
 		const int reachable_flag = 1;
 		int i, count = 0;
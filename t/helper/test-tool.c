@@ -12,6 +12,7 @@ static const char * const test_tool_usage[] = {
 static struct test_cmd cmds[] = {
 	{ "advise", cmd__advise_if_enabled },
 	{ "bitmap", cmd__bitmap },
+	{ "bitmap-speed", cmd__bitmap_speed },
 	{ "bloom", cmd__bloom },
 	{ "bundle-uri", cmd__bundle_uri },
 	{ "cache-tree", cmd__cache_tree },
@@ -37,6 +38,7 @@ static struct test_cmd cmds[] = {
 	{ "genzeros", cmd__genzeros },
 	{ "getcwd", cmd__getcwd },
 	{ "hashmap", cmd__hashmap },
+	{ "hash-lookup-speed", cmd__hash_lookup_speed },
 	{ "hash-speed", cmd__hash_speed },
 	{ "hexdump", cmd__hexdump },
 	{ "json-writer", cmd__json_writer },
@@ -87,6 +89,8 @@ static struct test_cmd cmds[] = {
 	{ "windows-named-pipe", cmd__windows_named_pipe },
 #endif
 	{ "write-cache", cmd__write_cache },
+	{ "xdiff-speed", cmd__xdiff_speed },
+	{ "zlib", cmd__zlib },
 };
 
 static NORETURN void die_usage(void)
@@ -0,0 +1,124 @@
+#include "test-tool.h"
+#include "parse-options.h"
+#include "strbuf.h"
+#include "trace.h"
+#include "xdiff-interface.h"
+#include "xdiff/xtypes.h"
+#include "xdiff/xdiffi.h"
+#include "xdiff/xutils.h"
+
+#define NUM_SECONDS 3
+
+static const char *const xdiff_speed_usage[] = {
+	"test-tool xdiff-speed [-w | -b | --ignore-space-at-eol | --ignore-cr-at-eol] <file>",
+	NULL
+};
+
+/*
+ * Split "buf" into lines the way xdl_prepare_ctx() does, hashing each
+ * of them, and return the number of lines seen.
+ */
+static unsigned long hash_lines(const struct strbuf *buf, long flags,
+				unsigned long *sum)
+{
+	const char *cur = buf->buf, *top = buf->buf + buf->len;
+	unsigned long nr = 0;
+
+	while (cur < top) {
+		*sum += xdl_hash_record(&cur, top, flags);
+		nr++;
+	}
+	return nr;
+}
+
+/*
+ * Compare every line of "a" with the same line of "b", which is an
+ * identical copy of it at a different address, so that xdl_recmatch()
+ * cannot take any shortcut based on the pointers.
+ */
+static unsigned long match_lines(const struct strbuf *a,
+				 const struct strbuf *b, long flags,
+				 unsigned long *sum)
+{
+	const char *l1 = a->buf, *l2 = b->buf, *top = a->buf + a->len;
+	unsigned long nr = 0;
+
+	while (l1 < top) {
+		const char *eol = memchr(l1, '\n', top - l1);
+		long len = eol ? eol - l1 + 1 : top - l1;
+
+		*sum += xdl_recmatch(l1, len, l2, len, flags);
+		l1 += len;
+		l2 += len;
+		nr++;
+	}
+	return nr;
+}
+
+static void report(const char *what, unsigned long iters,
+		   unsigned long lines, size_t size,
+		   clock_t start, clock_t end)
+{
+	double secs = ((double)end - start) / CLOCKS_PER_SEC;
+
+	printf("%s: %lu iters; %0.2f Mlines/s; %0.2f MiB/s\n", what, iters,
+	       lines / secs / 1e6, (double)iters * size / secs / (1024 * 1024));
+}
+
+int cmd__xdiff_speed(int argc, const char **argv)
+{
+	struct strbuf buf = STRBUF_INIT, copy = STRBUF_INIT;
+	unsigned long j, lines, sum = 0;
+	clock_t initial, start, end;
+	long flags = 0;
+	struct option options[] = {
+		OPT_BIT('w', "ignore-all-space", &flags,
+			"ignore whitespace when comparing lines",
+			XDF_IGNORE_WHITESPACE),
+		OPT_BIT('b', "ignore-space-change", &flags,
+			"ignore changes in amount of whitespace",
+			XDF_IGNORE_WHITESPACE_CHANGE),
+		OPT_BIT(0, "ignore-space-at-eol", &flags,
+			"ignore changes in whitespace at EOL",
+			XDF_IGNORE_WHITESPACE_AT_EOL),
+		OPT_BIT(0, "ignore-cr-at-eol", &flags,
+			"ignore carrier-return at the end of line",
+			XDF_IGNORE_CR_AT_EOL),
+		OPT_END()
+	};
+
+	argc = parse_options(argc, argv, NULL, options, xdiff_speed_usage, 0);
+	if (argc != 1)
+		usage_with_options(xdiff_speed_usage, options);
+	if (strbuf_read_file(&buf, argv[0], 0) < 0)
+		die_errno("unable to read '%s'", argv[0]);
+	if (!buf.len)
+		die("'%s' is empty", argv[0]);
+	strbuf_addbuf(&copy, &buf);
+
+	/* Use this as an offset to make overflow less likely. */
+	initial = clock();
+
+	start = end = clock() - initial;
+	for (j = lines = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+		lines += hash_lines(&buf, flags, &sum);
+		if (!(j & 15))
+			end = clock() - initial;
+	}
+	report("hash", j, lines, buf.len, start, end);
+
+	start = end = clock() - initial;
+	for (j = lines = 0; ((end - start) / CLOCKS_PER_SEC) < NUM_SECONDS; j++) {
+		lines += match_lines(&buf, &copy, flags, &sum);
+		if (!(j & 15))
+			end = clock() - initial;
+	}
+	report("match", j, lines, buf.len, start, end);
+
+	/* Make sure the compiler cannot optimize the loops away. */
+	trace_printf("checksum: %lu\n", sum);
+
+	strbuf_release(&buf);
+	strbuf_release(&copy);
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "test-tool.h"
+#include "git-compat-util.h"
+#include "git-zlib.h"
+#include "strbuf.h"
+#include "write-or-die.h"
+
+static const char *zlib_usage = "test-tool zlib inflate";
+
+/*
+ * Inflate the zlib stream on stdin to stdout. Anything following the end
+ * of the stream is ignored.
+ */
+static int do_inflate(void)
+{
+	struct strbuf in = STRBUF_INIT;
+	git_zstream stream;
+	unsigned char out[8192];
+	int status;
+
+	if (strbuf_read(&in, 0, 0) < 0)
+		die_errno("unable to read stdin");
+
+	memset(&stream, 0, sizeof(stream));
+	git_inflate_init(&stream);
+	stream.next_in = (unsigned char *)in.buf;
+	stream.avail_in = in.len;
+	do {
+		stream.next_out = out;
+		stream.avail_out = sizeof(out);
+		status = git_inflate(&stream, 0);
+		if (status != Z_OK && status != Z_STREAM_END)
+			die("inflate failed: %d", status);
+		write_or_die(1, out, stream.next_out - out);
+	} while (status == Z_OK);
+	git_inflate_end(&stream);
+
+	strbuf_release(&in);
+	return 0;
+}
+
+int cmd__zlib(int argc, const char **argv)
+{
+	if (argc == 2 && !strcmp(argv[1], "inflate"))
+		return do_inflate();
+	usage(zlib_usage);
+}
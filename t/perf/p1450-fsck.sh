@@ -6,6 +6,28 @@ test_description='Test fsck performance'
 
 test_perf_large_repo
 
+# Rather than counting up and doubling each time, count down from the endpoint,
+# halving each time. That ensures that our final test uses as many threads as
+# CPUs, even if it isn't a power of 2.
+test_expect_success 'set up thread-counting tests' '
+	t=$(test-tool online-cpus) &&
+	threads= &&
+	while test $t -gt 0
+	do
+		threads="$t $threads" &&
+		t=$((t / 2)) || return 1
+	done
+'
+
+for t in $threads
+do
+	THREADS=$t
+	export THREADS
+	test_perf "fsck $t threads" --prereq PERF_EXTRA '
+		git fsck --threads=$THREADS
+	'
+done
+
 test_perf 'fsck' '
 	git fsck
 '
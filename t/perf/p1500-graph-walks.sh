@@ -78,4 +78,20 @@ test_perf 'is-base check: git for-each-ref (disjoint-base)' '
 	git for-each-ref --format="%(is-base:refs/heads/disjoint-base)" --stdin <refs
 '
 
+test_perf 'contains: git branch --contains' '
+	xargs git branch --contains=HEAD~100 <branches
+'
+
+test_expect_success 'write reachability bitmaps' '
+	git repack -adb
+'
+
+test_perf 'ahead-behind counts: git for-each-ref (bitmaps)' '
+	git for-each-ref --format="%(ahead-behind:HEAD)" --stdin <refs
+'
+
+test_perf 'contains: git branch --contains (bitmaps)' '
+	xargs git branch --contains=HEAD~100 <branches
+'
+
 test_done
@@ -18,6 +18,10 @@ test_perf 'log -p -3000 (Myers)' '
 	git log -p -3000 >/dev/null
 '
 
+test_perf 'log -p -3000 (Myers, all threads)' '
+	git -c diff.threads=0 log -p -3000 >/dev/null
+'
+
 test_perf 'log -p -3000 --histogram' '
 	git log -p -3000 --histogram >/dev/null
 '
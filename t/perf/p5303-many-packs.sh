@@ -80,6 +80,16 @@ test_expect_success 'simplify reachability' '
 	git repack -ad
 '
 
+# Names of objects that are in none of the packs, like those a fetch
+# negotiation asks about; rotating the hex digits of real ones gives
+# us a plausible distribution.
+test_expect_success 'generate missing object names' '
+	git rev-list --objects --all |
+	head -n 100000 |
+	cut -d" " -f1 |
+	tr 0-9a-f 1-9a-f0 >missing
+'
+
 for nr_packs in 1 50 1000
 do
 	test_expect_success "create $nr_packs-pack scenario" '
@@ -94,6 +104,10 @@ do
 		git rev-list --abbrev-commit HEAD >/dev/null
 	'
 
+	test_perf "missing objects ($nr_packs)" '
+		git cat-file --batch-check <missing >/dev/null
+	'
+
 	# This simulates the interesting part of the repack, which is the
 	# actual pack generation, without smudging the on-disk setup
 	# between trials.
@@ -0,0 +1,38 @@
+#!/bin/sh
+
+test_description='Test the speed of finding deltas
+
+The first test times a single diff_delta() between two versions of the
+largest blob at HEAD, the others look for deltas between the objects of
+the 100 most recent commits without reusing any existing ones.
+'
+. ./perf-lib.sh
+
+test_perf_large_repo
+
+test_expect_success 'setup' '
+	git ls-tree -r -l HEAD >tree &&
+	sort -n -k 4 tree | tail -n 1 >largest &&
+	path=$(cut -f 2 largest) &&
+	git cat-file blob "HEAD:$path" >target &&
+	base=$(git log -n 10 --format="%H" -- "$path" | tail -n 1) &&
+	git cat-file blob "$base:$path" >base &&
+
+	git rev-list --objects --max-count=100 HEAD >objects
+'
+
+test_perf 'diff_delta of the largest blob' '
+	test-tool delta -d base target delta
+'
+
+test_perf 'pack-objects --no-reuse-delta (1 thread)' '
+	git pack-objects --no-reuse-delta --threads=1 --stdout \
+		<objects >/dev/null
+'
+
+test_perf 'pack-objects --no-reuse-delta (all threads)' '
+	git pack-objects --no-reuse-delta --threads=0 --stdout \
+		<objects >/dev/null
+'
+
+test_done
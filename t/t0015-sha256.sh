@@ -0,0 +1,33 @@
+#!/bin/sh
+
+test_description='test the built-in SHA-256 implementations'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	printf abc >abc &&
+	for size in 1 55 56 63 64 65 119 128 1000 65537
+	do
+		test-tool genrandom $size $size >data-$size || return 1
+	done
+'
+
+test_expect_success 'known answer' '
+	echo ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad >expect &&
+	test-tool sha256 <abc >actual &&
+	test_cmp expect actual &&
+	GIT_TEST_SHA256_PORTABLE=1 test-tool sha256 <abc >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'portable code agrees with the one picked for this CPU' '
+	for f in data-*
+	do
+		GIT_TEST_SHA256_PORTABLE=1 test-tool sha256 <$f >expect &&
+		test-tool sha256 <$f >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_done
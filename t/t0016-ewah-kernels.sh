@@ -0,0 +1,26 @@
+#!/bin/sh
+
+test_description='portable and CPU-specific bitmap word operations'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+t_bitmap="$GIT_BUILD_DIR/t/unit-tests/bin/t-bitmap$X"
+
+test_lazy_prereq T_BITMAP '
+	test -x "$t_bitmap"
+'
+
+test_expect_success T_BITMAP 'bitmap operations with the kernels for this CPU' '
+	"$t_bitmap" >out &&
+	test_grep ! "^not ok" out
+'
+
+test_expect_success T_BITMAP 'bitmap operations with the portable kernels' '
+	GIT_TEST_EWAH_PORTABLE=1 "$t_bitmap" >out &&
+	test_grep ! "^not ok" out &&
+	grep "^ok" out >ok &&
+	test_grep ! -v "(portable)$" ok
+'
+
+test_done
@@ -1295,6 +1295,124 @@ test_expect_success 'batch-command flush without --buffer' '
 	grep "^fatal:.*flush is only for --buffer mode.*" err
 '
 
+test_expect_success 'setup objects for --prefetch' '
+	git -C all-two cat-file --batch-all-objects \
+		--batch-check="%(objectname)" >prefetch-oids &&
+	{
+		cat prefetch-oids &&
+		echo HEAD &&
+		echo "$(test_oid deadbeef) with rest" &&
+		sed -n 1p prefetch-oids
+	} >prefetch-in &&
+	sed "s/^/contents /" prefetch-in >prefetch-cmd &&
+	echo flush >>prefetch-cmd
+'
+
+for n in 1 3 100
+do
+	test_expect_success "--batch --prefetch=$n gives the same output" '
+		git -C all-two cat-file --batch="%(objectname) %(rest)" \
+			--buffer <prefetch-in >expect &&
+		git -C all-two cat-file --batch="%(objectname) %(rest)" \
+			--buffer --prefetch=$n <prefetch-in >actual &&
+		test_cmp expect actual
+	'
+
+	test_expect_success "--batch-command --prefetch=$n gives the same output" '
+		git -C all-two cat-file --batch-command \
+			--buffer <prefetch-cmd >expect &&
+		git -C all-two cat-file --batch-command \
+			--buffer --prefetch=$n <prefetch-cmd >actual &&
+		test_cmp expect actual
+	'
+done
+
+test_expect_success '--prefetch requires --buffer' '
+	test_must_fail git cat-file --batch --prefetch=2 </dev/null 2>err &&
+	test_grep "requires .--buffer" err &&
+	test_must_fail git cat-file --batch --buffer --prefetch=-1 \
+		</dev/null 2>err &&
+	test_grep "must be non-negative" err
+'
+
+test_expect_success '--prefetch is incompatible with --batch-all-objects' '
+	test_must_fail git cat-file --batch-check --batch-all-objects \
+		--prefetch=2 2>err &&
+	test_grep "cannot be used together" err
+'
+
+test_expect_success 'setup objects for --compressed' '
+	git init compressed &&
+	(
+		cd compressed &&
+		test_seq 1 1000 >base &&
+		git add base &&
+		git commit -m base &&
+		test_seq 1 1001 >base &&
+		echo loose >loose &&
+		git add base loose &&
+		git commit -m delta &&
+		git repack -adf &&
+		git rm loose &&
+		echo loose-object >loose &&
+		git add loose &&
+		git commit -m loose
+	)
+'
+
+test_expect_success '--compressed shows objects as zlib streams' '
+	git -C compressed rev-list --objects --all >objs &&
+	cut -d" " -f1 objs >oids &&
+	while read oid
+	do
+		echo "$oid" |
+		git -C compressed cat-file --batch= --compressed >out &&
+		tail -c +2 out | test-tool zlib inflate >actual &&
+		git -C compressed cat-file $(git -C compressed cat-file -t $oid) \
+			$oid >expect &&
+		test_cmp expect actual || return 1
+	done <oids
+'
+
+test_expect_success '--compressed reports the size of the zlib stream' '
+	while read oid
+	do
+		echo "$oid" >in &&
+		git -C compressed cat-file --batch --compressed <in >out &&
+		head -n 1 out >actual &&
+		git -C compressed cat-file --compressed \
+			--batch-check="%(objectname) %(objecttype) %(objectsize) %(objectsize:compressed)" \
+			<in >expect &&
+		test_cmp expect actual || return 1
+	done <oids
+'
+
+test_expect_success '--compressed copies undeltified packed objects as-is' '
+	oid=$(git -C compressed rev-parse HEAD~1:base) &&
+	echo $oid >in &&
+	git -C compressed cat-file --compressed \
+		--batch-check="%(objectsize:disk) %(objectsize:compressed) %(deltabase)" \
+		<in >out &&
+	read disk compressed base <out &&
+	test "$base" = "$(test_oid zero)" &&
+	# the pack entry is an object header of at most a few bytes,
+	# followed by the zlib stream
+	test $compressed -lt $disk &&
+	test $compressed -ge $(($disk - 4))
+'
+
+test_expect_success '%(objectsize:compressed) requires --compressed' '
+	echo HEAD >in &&
+	test_must_fail git cat-file --batch-check="%(objectsize:compressed)" \
+		<in 2>err &&
+	test_grep "requires --compressed" err
+'
+
+test_expect_success '--compressed is incompatible with conversions' '
+	test_must_fail git cat-file --batch --compressed --textconv </dev/null &&
+	test_must_fail git cat-file --batch --compressed --use-mailmap </dev/null
+'
+
 script='
 use warnings;
 use strict;
@@ -55,6 +55,28 @@ large -c pack.compression=0
 small -c pack.compression=9
 EOF
 
+test_expect_success PTHREADS 'add duplicate large files with core.checksumThread' '
+	test_when_finished "rm -f .git/objects/pack/pack-*.* .git/index" &&
+	git -c core.checksumThread=true -c core.compression=0 \
+		add large1 large2 large3 &&
+	idx=$(echo .git/objects/pack/pack-*.idx) &&
+	git verify-pack "$idx" &&
+	test $(git show-index <"$idx" | wc -l) = 1
+'
+
+test_expect_success PTHREADS 'split large files over packs with core.checksumThread' '
+	test_when_finished "rm -f .git/objects/pack/pack-*.* .git/index" &&
+	git -c core.checksumThread=true -c core.compression=0 \
+		-c pack.packSizeLimit=3m add large1 huge &&
+	count=0 &&
+	for idx in .git/objects/pack/pack-*.idx
+	do
+		git verify-pack "$idx" &&
+		count=$(( $count + 1 )) || return 1
+	done &&
+	test $count = 2
+'
+
 test_expect_success 'add a large file or two' '
 	git add large1 huge large2 &&
 	# make sure we got a single packfile and no loose objects
@@ -822,6 +822,30 @@ test_expect_success 'fsck errors in packed objects' '
 	! grep corrupt out
 '
 
+test_expect_success 'fsck --threads reports packed objects in pack order' '
+	git cat-file commit HEAD >basis &&
+	for i in 1 2 3 4 5 6 7 8
+	do
+		sed "s/</bad$i/" basis >bad &&
+		git hash-object --literally -t commit -w bad || return 1
+	done >bad-commits &&
+	pack=$(git pack-objects .git/objects/pack/pack <bad-commits) &&
+	test_when_finished "rm -f .git/objects/pack/pack-$pack.*" &&
+	while read oid
+	do
+		remove_object $oid || return 1
+	done <bad-commits &&
+	test_must_fail git fsck --threads=1 2>expect &&
+	test_must_fail git fsck --threads=4 2>actual &&
+	test_cmp expect actual &&
+	test_grep "bad name" actual &&
+
+	# With a tiny budget, only one object is inflated at a time.
+	test_must_fail git -c core.deltaBaseCacheLimit=1 \
+		fsck --threads=4 2>actual &&
+	test_cmp expect actual
+'
+
 test_expect_success 'fsck fails on corrupt packfile' '
 	hsh=$(git commit-tree -m mycommit HEAD^{tree}) &&
 	pack=$(echo $hsh | git pack-objects .git/objects/pack/pack) &&
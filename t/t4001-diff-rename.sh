@@ -310,4 +310,98 @@ test_expect_success 'last line matters too' '
 	test_cmp expected actual.munged
 '
 
+test_expect_success 'threaded rename detection matches serial' '
+	git init threaded &&
+	(
+		cd threaded &&
+		for i in $(test_seq 1 20)
+		do
+			test_seq $i $(($i * 5 + 20)) >file$i || return 1
+		done &&
+		git add . &&
+		git commit -m original &&
+		for i in $(test_seq 1 20)
+		do
+			mv file$i moved$i &&
+			echo changed >>moved$i || return 1
+		done &&
+		git add -A &&
+		git commit -m moved &&
+		git diff-tree -r -M --name-status HEAD^ HEAD >expect &&
+		GIT_TEST_RENAME_THREADS=1 \
+			git diff-tree -r -M --name-status HEAD^ HEAD >actual &&
+		test_cmp expect actual &&
+		GIT_TEST_RENAME_THREADS=1 git -c diff.renameThreads=3 \
+			diff-tree -r -M --name-status HEAD^ HEAD >actual &&
+		test_cmp expect actual &&
+		test_grep ! "^[AD]" actual
+	)
+'
+
+test_expect_success 'setup for reusing rename signatures' '
+	git init signatures &&
+	(
+		cd signatures &&
+		echo "*.bin diff=bin" >.gitattributes &&
+		test_seq 1 100 | sed "s/$/Q/" | q_to_cr >a.txt &&
+		cp a.txt c.bin &&
+		git add . &&
+		git commit -m base &&
+
+		git mv a.txt b.txt &&
+		test_seq 200 230 >>b.txt &&
+		git commit -a -m text &&
+
+		git mv c.bin d.bin &&
+		cp b.txt d.bin &&
+		git commit -a -m binary
+	)
+'
+
+# One "git log -M" reuses the signatures of the blobs across commits,
+# which must give the same result as looking at each commit on its own.
+# The same blobs are renamed once under a path that is treated as text
+# and once under one that may be binary, which changes their signature.
+for binary in true false
+do
+	test_expect_success "reused rename signatures (diff.bin.binary=$binary)" '
+		(
+			cd signatures &&
+			for rev in HEAD HEAD^
+			do
+				git -c diff.bin.binary=$binary diff-tree \
+					-r -M --name-status $rev || return 1
+			done >expect &&
+			git -c diff.bin.binary=$binary log -M --name-status \
+				--format=%H -2 >actual &&
+			grep -v "^$" actual >actual.clean &&
+			test_cmp expect actual.clean &&
+
+			git -c diff.bin.binary=$binary log -M --name-status \
+				--format=%H --reverse -2 >actual &&
+			grep -v "^$" actual >actual.clean &&
+			for rev in HEAD^ HEAD
+			do
+				git -c diff.bin.binary=$binary diff-tree \
+					-r -M --name-status $rev || return 1
+			done >expect &&
+			test_cmp expect actual.clean
+		)
+	'
+done
+
+test_expect_success 'rename signatures of text and binary paths differ' '
+	(
+		cd signatures &&
+		git -c diff.bin.binary=true diff-tree -r -M --name-status \
+			HEAD^ >text &&
+		git -c diff.bin.binary=true diff-tree -r -M --name-status \
+			HEAD >binary &&
+		grep "^R" text | cut -f1 >text.score &&
+		grep "^R" binary | cut -f1 >binary.score &&
+		test_line_count = 1 text.score &&
+		! test_cmp text.score binary.score
+	)
+'
+
 test_done
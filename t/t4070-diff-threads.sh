@@ -0,0 +1,109 @@
+#!/bin/sh
+
+test_description='patches computed on multiple threads'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	for i in $(test_seq 1 40)
+	do
+		test_seq $i $(($i * 3 + 40)) >file$i || return 1
+	done &&
+	printf "binary\0file" >binary &&
+	cp file1 copy-source &&
+	echo "*.conv diff=upcase" >.gitattributes &&
+	test_write_lines a b c >text.conv &&
+	git add . &&
+	git commit -m base &&
+
+	for i in $(test_seq 1 40)
+	do
+		sed -e "s/^$(($i + 5))\$/changed $i  /" file$i >tmp &&
+		mv tmp file$i || return 1
+	done &&
+	git mv file7 moved7 &&
+	rm file9 &&
+	printf "binary\0file2" >binary &&
+	cp copy-source copied &&
+	echo more >>copy-source &&
+	test_write_lines a B c >text.conv &&
+	test_seq 1 20 >new &&
+	test_ln_s_add file1 link &&
+	test_chmod +x file2 &&
+	git add . &&
+	git commit -m change &&
+
+	git config diff.upcase.textconv "tr a-z A-Z <"
+'
+
+while read opts
+do
+	test_expect_success "threaded patch is the same: $opts" '
+		git -c diff.threads=1 log -1 $opts >expect &&
+		git -c diff.threads=4 log -1 $opts >actual &&
+		test_cmp expect actual
+	'
+done <<\EOF
+-p
+--stat -p
+-p -C -C
+-p --color --color-moved
+-p --word-diff
+-p --binary
+-p -w --ignore-blank-lines
+-p -B
+-p -R --histogram
+-p --no-textconv
+-p --graph
+-p --ext-diff
+EOF
+
+test_expect_success 'threads are used for regular files' '
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git -c diff.threads=4 log -1 -p >/dev/null &&
+	grep "\"key\":\"patch/threaded\"" trace.event
+'
+
+test_expect_success 'threaded diff of the worktree' '
+	echo worktree >>file3 &&
+	git -c diff.threads=1 diff HEAD~1 >expect &&
+	git -c diff.threads=4 diff HEAD~1 >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'threaded diff of worktree files with a clean filter' '
+	test_config filter.rot13.clean "tr a-zA-Z n-za-mN-ZA-M" &&
+	echo "file1[0-7] filter=rot13" >>.gitattributes &&
+	test_when_finished "git checkout .gitattributes" &&
+	for i in $(test_seq 10 17)
+	do
+		echo "more text" >>file$i || return 1
+	done &&
+	git -c diff.threads=1 diff HEAD~1 >expect &&
+	git -c diff.threads=4 diff HEAD~1 >actual &&
+	test_cmp expect actual &&
+	test_grep "^+zber grkg" actual
+'
+
+test_expect_success 'threaded patch of complete rewrites' '
+	for i in $(test_seq 10 17)
+	do
+		test_seq 100 150 | sed -e "s/^/rewritten $i /" >file$i || return 1
+	done &&
+	git commit -m rewrite file1[0-7] &&
+	git -c diff.threads=1 log -1 -p -B >expect &&
+	git -c diff.threads=4 log -1 -p -B >actual &&
+	test_grep "^dissimilarity index" actual &&
+	test_cmp expect actual &&
+	git -c diff.threads=1 log -1 -p -B -M --stat >expect &&
+	git -c diff.threads=4 log -1 -p -B -M --stat >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'diff.threads rejects negative values' '
+	test_must_fail git -c diff.threads=-1 log -1 -p 2>err &&
+	test_grep "invalid number of threads" err
+'
+
+test_done
@@ -389,6 +389,38 @@ test_expect_success '--max-new-filters overrides configuration' '
 	)
 '
 
+test_expect_success 'Bloom generation is limited by --max-new-filter-time' '
+	git init time-limit &&
+	test_when_finished "rm -fr time-limit" &&
+	(
+		cd time-limit &&
+		test_commit one &&
+		test_commit two &&
+
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git commit-graph write --reachable --changed-paths \
+				--split --max-new-filter-time=0 &&
+		test_filter_computed 0 trace.event &&
+		test_filter_not_computed 2 trace.event &&
+		test_line_count = 1 .git/objects/info/commit-graphs/commit-graph-chain &&
+
+		# Commits without a filter are still found by a path query.
+		git log --format=%s -- one.t >actual &&
+		echo one >expect &&
+		test_cmp expect actual &&
+
+		# A later write fills in the missing filters.
+		test_config commitGraph.maxNewFilterTime 0 &&
+		rm -f trace.event &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git commit-graph write --reachable --changed-paths \
+				--split=replace --no-max-new-filter-time &&
+		test_filter_computed 2 trace.event &&
+		test_filter_not_computed 0 trace.event
+	)
+'
+
 test_expect_success 'Bloom generation backfills empty commits' '
 	git init empty &&
 	test_when_finished "rm -fr empty" &&
@@ -566,6 +566,126 @@ test_expect_success 'pack-objects in too-many-packs mode' '
 	git fsck
 '
 
+test_expect_success PTHREADS 'pack-objects checks objects on multiple threads' '
+	test_when_finished "rm -rf many" &&
+	git init many &&
+	(
+		cd many &&
+		for i in $(test_seq 1 8)
+		do
+			for j in $(test_seq 1 80)
+			do
+				test_seq $j $(($j + $i + 40)) >file$j || return 1
+			done &&
+			git add . &&
+			git commit -q -m "commit $i" || return 1
+		done &&
+		git repack -adf &&
+
+		git pack-objects --window=0 --threads=1 --stdout --all \
+			</dev/null >serial.pack &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git pack-objects --window=0 --threads=4 --stdout --all \
+			</dev/null >threaded.pack &&
+		grep "\"key\":\"check-object/threads\"" trace.event &&
+		test_cmp_bin serial.pack threaded.pack &&
+		git index-pack --strict -o threaded.idx threaded.pack &&
+		git verify-pack -v threaded.idx >stat &&
+		grep "^chain length = 1:" stat
+	)
+'
+
+test_expect_success PTHREADS 'pack-objects deflates objects on multiple threads' '
+	test_when_finished "rm -rf deflate" &&
+	git init deflate &&
+	(
+		cd deflate &&
+		for i in $(test_seq 1 4)
+		do
+			for j in $(test_seq 1 40)
+			do
+				test_seq $j $(($j + $i + 40)) >file$j || return 1
+			done &&
+			git add . &&
+			git commit -q -m "commit $i" || return 1
+		done &&
+
+		for opts in --no-reuse-object --no-reuse-delta
+		do
+			git pack-objects $opts --window=0 --threads=1 --stdout \
+				--all </dev/null >serial.pack &&
+			GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+			git pack-objects $opts --window=0 --threads=4 --stdout \
+				--all </dev/null >threaded.pack &&
+			test_cmp_bin serial.pack threaded.pack || return 1
+		done &&
+		grep "\"key\":\"write-ahead/threads\"" trace.event &&
+
+		git repack -adf --threads=4 &&
+		git fsck
+	)
+'
+
+test_expect_success PTHREADS 'index-pack hashes objects on multiple threads' '
+	test_when_finished "rm -rf hash-threads" &&
+	git init hash-threads &&
+	(
+		cd hash-threads &&
+		for i in $(test_seq 1 40)
+		do
+			test_seq $i $(($i * 7)) >file$i || return 1
+		done &&
+		git add . &&
+		git commit -q -m base &&
+		git pack-objects --window=0 --stdout --all </dev/null >test.pack &&
+
+		git index-pack --threads=1 -o serial.idx test.pack &&
+		GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+		git index-pack --strict --threads=4 -o threaded.idx test.pack &&
+		grep "\"key\":\"hash-objects/threads\"" trace.event &&
+		test_cmp_bin serial.idx threaded.idx &&
+		git -c core.bigFileThreshold=100 index-pack --threads=4 \
+			-o big.idx test.pack &&
+		test_cmp_bin serial.idx big.idx
+	)
+'
+
+test_expect_success PTHREADS 'files are the same with core.checksumThread' '
+	test_when_finished "rm -rf checksum-thread" &&
+	git init checksum-thread &&
+	(
+		cd checksum-thread &&
+		test-tool genrandom a 400000 >big &&
+		for i in $(test_seq 1 100)
+		do
+			echo $i >file$i || return 1
+		done &&
+		git add . &&
+		git commit -q -m base &&
+
+		git pack-objects --stdout --all </dev/null >serial.pack &&
+		git -c core.checksumThread=true pack-objects --stdout --all \
+			</dev/null >threaded.pack &&
+		test_cmp_bin serial.pack threaded.pack &&
+
+		git index-pack -o serial.idx serial.pack &&
+		git -c core.checksumThread=true index-pack -o threaded.idx \
+			threaded.pack &&
+		test_cmp_bin serial.idx threaded.idx &&
+
+		rm .git/index &&
+		git read-tree HEAD &&
+		mv .git/index serial.index &&
+		git -c core.checksumThread=true read-tree HEAD &&
+		test_cmp_bin serial.index .git/index &&
+
+		git commit-graph write --reachable &&
+		mv .git/objects/info/commit-graph serial.graph &&
+		git -c core.checksumThread=true commit-graph write --reachable &&
+		test_cmp_bin serial.graph .git/objects/info/commit-graph
+	)
+'
+
 test_expect_success 'setup: fake a SHA1 hash collision' '
 	git init corrupt &&
 	(
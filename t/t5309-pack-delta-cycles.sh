@@ -1,6 +1,6 @@
 #!/bin/sh
 
-test_description='test index-pack handling of delta cycles in packfiles'
+test_description='test index-pack and unpack-objects handling of delta cycles in packfiles'
 
 TEST_PASSES_SANITIZE_LEAK=true
 . ./test-lib.sh
@@ -76,4 +76,19 @@ test_expect_success 'failover to a duplicate object in the same pack' '
 	test_must_fail git index-pack --fix-thin --stdin <recoverable.pack
 '
 
+test_expect_success 'unpack-objects resolves deltas queued on a later base' '
+	test_when_finished "rm -rf unpack" &&
+	git init unpack &&
+	git -C unpack unpack-objects <ab.pack &&
+	git -C unpack cat-file -t $A &&
+	git -C unpack cat-file -t $B
+'
+
+test_expect_success 'unpack-objects detects REF_DELTA cycles' '
+	test_when_finished "rm -rf unpack" &&
+	git init unpack &&
+	test_must_fail git -C unpack unpack-objects <cycle.pack 2>err &&
+	test_grep "unresolved deltas" err
+'
+
 test_done
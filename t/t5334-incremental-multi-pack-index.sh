@@ -5,6 +5,7 @@ test_description='incremental multi-pack-index'
 TEST_PASSES_SANITIZE_LEAK=true
 . ./test-lib.sh
 . "$TEST_DIRECTORY"/lib-midx.sh
+. "$TEST_DIRECTORY"/lib-bitmap.sh
 
 GIT_TEST_MULTI_PACK_INDEX=0
 export GIT_TEST_MULTI_PACK_INDEX
@@ -45,4 +46,106 @@ test_expect_success 'convert incremental to non-incremental' '
 
 compare_results_with_midx 'non-incremental MIDX conversion'
 
+test_expect_success 'write bitmaps for incremental MIDX layers' '
+	git init bitmaps &&
+	(
+		cd bitmaps &&
+
+		test_commit one &&
+		git repack -d &&
+		git multi-pack-index write --bitmap --incremental &&
+
+		for c in two three
+		do
+			test_commit $c &&
+			git repack -d &&
+			GIT_TRACE2_EVENT="$(pwd)/trace2.txt" \
+				git multi-pack-index write --bitmap --incremental ||
+			return 1
+		done &&
+
+		test_line_count = 3 $midx_chain &&
+		for hash in $(cat $midx_chain)
+		do
+			test_path_is_file $midxdir/multi-pack-index-$hash.bitmap ||
+			return 1
+		done &&
+
+		# The bitmaps of the earlier layers were reused rather than
+		# regenerated.
+		grep "\"key\":\"building_bitmaps_reused\",\"value\":\"[1-9]" trace2.txt
+	)
+'
+
+test_expect_success 'reachability queries with incremental MIDX bitmaps' '
+	(
+		cd bitmaps &&
+
+		for c in one two three
+		do
+			git rev-list --test-bitmap $c || return 1
+		done &&
+
+		git rev-list --objects --use-bitmap-index --all >actual &&
+		git rev-list --objects --all >expect &&
+		test_bitmap_traversal expect actual &&
+
+		git rev-list --objects --use-bitmap-index one..three >actual &&
+		git rev-list --objects one..three >expect &&
+		test_bitmap_traversal expect actual &&
+
+		git rev-list --count --use-bitmap-index --all >actual &&
+		git rev-list --count --all >expect &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'pack-objects with incremental MIDX bitmaps' '
+	(
+		cd bitmaps &&
+
+		git pack-objects --all --stdout --use-bitmap-index \
+			</dev/null >all.pack &&
+		git index-pack all.pack &&
+		git show-index <all.idx >idx &&
+		git rev-list --objects --all >objects &&
+		test_line_count = $(wc -l <objects) idx
+	)
+'
+
+test_expect_success 'no bitmap for a layer on top of one without' '
+	git init no-base-bitmap &&
+	(
+		cd no-base-bitmap &&
+
+		test_commit one &&
+		git repack -d &&
+		git multi-pack-index write --incremental &&
+
+		test_commit two &&
+		git repack -d &&
+		git multi-pack-index write --bitmap --incremental 2>err &&
+		test_grep "has no bitmap" err &&
+
+		test_line_count = 2 $midx_chain &&
+		find $midxdir -name "*.bitmap" >bitmaps &&
+		test_must_be_empty bitmaps
+	)
+'
+
+test_expect_success 'compact incremental MIDX with bitmaps' '
+	(
+		cd bitmaps &&
+
+		git multi-pack-index write --bitmap &&
+
+		test_path_is_file $packdir/multi-pack-index &&
+		ls $packdir/multi-pack-index-*.bitmap >bitmaps &&
+		test_line_count = 1 bitmaps &&
+		test_dir_is_empty $midxdir &&
+
+		git rev-list --test-bitmap three
+	)
+'
+
 test_done
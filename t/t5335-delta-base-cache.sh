@@ -0,0 +1,82 @@
+#!/bin/sh
+
+test_description='delta base cache statistics'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	for i in $(test_seq 1 20)
+	do
+		test_seq 1 $((i * 50)) >one &&
+		test_seq 2 $((i * 40)) >two &&
+		git add one two &&
+		git commit -q -m "$i" || return 1
+	done &&
+	git repack -adf
+'
+
+test_expect_success 'delta base cache lookups are counted' '
+	GIT_TRACE2_PERF="$(pwd)/trace" git log -p >/dev/null &&
+	grep "delta-base-c.*name:hits value:[1-9]" trace &&
+	grep "delta-base-c.*name:misses value:[1-9]" trace &&
+	! grep "delta-base-c.*name:evictions" trace
+'
+
+counter () {
+	sed -n "s/.*delta-base-c.*name:$1 value:\([0-9]*\).*/\1/p" trace |
+	tail -n 1
+}
+
+test_expect_success 'every delta base cache lookup is a hit or a miss' '
+	rm -f trace &&
+	GIT_TRACE2_PERF="$(pwd)/trace" git log -p >/dev/null &&
+	lookups=$(counter lookups) &&
+	hits=$(counter hits) &&
+	misses=$(counter misses) &&
+	test "$lookups" -gt 0 &&
+	test "$((hits + misses))" = "$lookups" &&
+
+	rm -f trace &&
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+		git cat-file --batch-all-objects --batch >/dev/null &&
+	lookups=$(counter lookups) &&
+	hits=$(counter hits) &&
+	misses=$(counter misses) &&
+	test "$lookups" -gt 0 &&
+	test "$((hits + misses))" = "$lookups"
+'
+
+test_expect_success 'each lookup of a delta base is counted once' '
+	git init single-delta &&
+	(
+		cd single-delta &&
+		test_seq 1 1000 >file &&
+		git add file &&
+		git commit -m base &&
+		test_seq 1 1001 >file &&
+		git commit -a -m delta &&
+		git repack -adf &&
+		git verify-pack -v .git/objects/pack/*.idx >verify &&
+		awk "NF == 7 { print \$1 }" verify >deltas &&
+		test_line_count = 1 deltas &&
+		delta=$(cat deltas) &&
+
+		# The first read misses both the delta and its base, which
+		# is then cached; the second one finds the base in the cache.
+		printf "%s\n%s\n" $delta $delta >in &&
+		GIT_TRACE2_PERF="$(pwd)/trace" git cat-file --batch <in >/dev/null &&
+		test "$(counter lookups)" = 4 &&
+		test "$(counter hits)" = 1 &&
+		test "$(counter misses)" = 3
+	)
+'
+
+test_expect_success 'delta base cache evictions are counted' '
+	rm -f trace &&
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+		git -c core.deltaBaseCacheLimit=1 log -p >/dev/null &&
+	grep "delta-base-c.*name:evictions value:[1-9]" trace
+'
+
+test_done
@@ -0,0 +1,39 @@
+#!/bin/sh
+
+test_description='mapping pack windows'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test-tool genrandom big 100000 >big &&
+	git add big &&
+	git commit -m big &&
+	git repack -adf
+'
+
+test_expect_success 'sliding windows are counted' '
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+		git -c core.packedGitWindowSize=8k -c core.packedGitLimit=16k \
+		cat-file blob HEAD:big >actual &&
+	test_cmp big actual &&
+	grep "pack-windows.*name:mapped value:[1-9][0-9]" trace &&
+	grep "pack-windows.*name:unmapped value:[1-9]" trace
+'
+
+test_expect_success 'core.packedGitMapWhole maps the pack once' '
+	rm -f trace &&
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+		git -c core.packedGitWindowSize=8k -c core.packedGitLimit=16k \
+		-c core.packedGitMapWhole=true \
+		cat-file blob HEAD:big >actual &&
+	test_cmp big actual &&
+	grep "pack-windows.*name:mapped value:1$" trace
+'
+
+test_expect_success 'verifying packs with whole mappings' '
+	git -c core.packedGitMapWhole=true fsck --full &&
+	git -c core.packedGitMapWhole=true verify-pack .git/objects/pack/*.idx
+'
+
+test_done
@@ -0,0 +1,40 @@
+#!/bin/sh
+
+test_description='skipping packs that cannot contain an object'
+
+TEST_PASSES_SANITIZE_LEAK=true
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	git config core.multiPackIndex false &&
+	for i in $(test_seq 1 5)
+	do
+		test_seq 1 $((i * 20)) >file &&
+		git add file &&
+		git commit -q -m "$i" &&
+		git repack -d || return 1
+	done &&
+	ls .git/objects/pack/*.pack >packs &&
+	test_line_count = 5 packs &&
+
+	git rev-list --objects --all | cut -d" " -f1 >present &&
+	for i in $(test_seq 1 300)
+	do
+		echo "missing $i" | git hash-object --stdin || return 1
+	done >missing
+'
+
+test_expect_success 'lookups give the same answers with filters' '
+	cat missing present missing >in &&
+	git cat-file --batch-check="%(objectname) %(objecttype)" <present >expect.present &&
+	sed "s/$/ missing/" missing >expect.missing &&
+	cat expect.missing expect.present expect.missing >expect &&
+	GIT_TRACE2_PERF="$(pwd)/trace" \
+		git cat-file --batch-check="%(objectname) %(objecttype)" \
+		<in >actual &&
+	test_cmp expect actual &&
+	grep "pack-oid-fi.*name:built value:1" trace &&
+	grep "pack-oid-fi.*name:skips value:[1-9]" trace
+'
+
+test_done
@@ -58,11 +58,15 @@ test_expect_success 'setup' '
 	git -c commitGraph.generationVersion=1 commit-graph write --reachable &&
 	mv .git/objects/info/commit-graph commit-graph-no-gdat &&
 	chmod u+w commit-graph-no-gdat &&
+	git repack -adb &&
+	ls .git/objects/pack/pack-*.bitmap >bitmap-name &&
+	mv "$(cat bitmap-name)" bitmap-full &&
 	git config core.commitGraph true
 '
 
 run_all_modes () {
-	test_when_finished rm -rf .git/objects/info/commit-graph &&
+	test_when_finished rm -rf .git/objects/info/commit-graph \
+		"$(cat bitmap-name)" &&
 	"$@" <input >actual &&
 	test_cmp expect actual &&
 	cp commit-graph-full .git/objects/info/commit-graph &&
@@ -73,6 +77,10 @@ run_all_modes () {
 	test_cmp expect actual &&
 	cp commit-graph-no-gdat .git/objects/info/commit-graph &&
 	"$@" <input >actual &&
+	test_cmp expect actual &&
+	rm .git/objects/info/commit-graph &&
+	cp bitmap-full "$(cat bitmap-name)" &&
+	"$@" <input >actual &&
 	test_cmp expect actual
 }
 
@@ -529,6 +537,53 @@ test_expect_success 'for-each-ref ahead-behind:none' '
 		--format="%(refname) %(ahead-behind:commit-8-4)" --stdin
 '
 
+test_expect_success 'ahead-behind and contains with partial bitmaps' '
+	git init bitmaps &&
+	(
+		cd bitmaps &&
+		git fetch .. "refs/heads/commit-*:refs/heads/commit-*" &&
+		git update-ref refs/heads/bulk commit-10-10 &&
+		test_commit_bulk --ref=refs/heads/bulk 300 &&
+		git repack -adb &&
+		git update-ref refs/heads/bulk-bitmapped bulk~10 &&
+		test_commit_bulk --ref=refs/heads/bulk 3 &&
+
+		git for-each-ref --format="%(refname)" >refs &&
+		for base in commit-5-5 bulk~150
+		do
+			while read ref
+			do
+				echo "$ref $(git rev-list --count $base..$ref)" \
+					"$(git rev-list --count $ref..$base)" ||
+				return 1
+			done <refs >expect &&
+			GIT_TRACE2_EVENT="$(pwd)/trace2.txt" git for-each-ref \
+				--format="%(refname) %(ahead-behind:$base)" >actual &&
+			test_cmp expect actual &&
+			grep "\"key\":\"bitmap_counts\",\"value\":\"[1-9]" trace2.txt &&
+			rm trace2.txt || return 1
+		done &&
+
+		for commit in commit-3-7 bulk~20 bulk
+		do
+			while read ref
+			do
+				if git merge-base --is-ancestor $commit $ref
+				then
+					echo $ref
+				fi || return 1
+			done <refs >expect &&
+			git for-each-ref --format="%(refname)" \
+				--contains=$commit >actual &&
+			test_cmp expect actual &&
+			git for-each-ref --format="%(refname)" \
+				--no-contains=$commit >actual &&
+			comm -23 refs expect >expect.no &&
+			test_cmp expect.no actual || return 1
+		done
+	)
+'
+
 test_expect_success 'for-each-ref merged:linear' '
 	cat >input <<-\EOF &&
 	refs/heads/commit-1-1
@@ -2801,6 +2801,21 @@ test_expect_success 'R: blob appears only once' '
 	test 1 = $n
 '
 
+test_expect_success PTHREADS 'R: duplicate big blob with core.checksumThread' '
+	git init R-thread &&
+	git --git-dir=R-thread/.git config fastimport.unpackLimit 0 &&
+	git --git-dir=R-thread/.git -c core.checksumThread=true \
+		fast-import --big-file-threshold=1 <input &&
+	(
+		cd R-thread &&
+		verify_packs -v >../verify-thread
+	) &&
+	n=$(grep $a verify-thread | wc -l) &&
+	test 1 = $n &&
+	git --git-dir=R-thread/.git cat-file blob big-file:big2 >actual &&
+	test_cmp_bin expect actual
+'
+
 ###
 ### series S (mark and path parsing)
 ###
@@ -0,0 +1,98 @@
+#include "test-lib.h"
+#include "ewah/ewok.h"
+
+static uint32_t rand_state = 1;
+
+static uint32_t next_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 16;
+}
+
+/*
+ * Make a bitmap of "nr" bits that has runs of clean words in it, for
+ * its EWAH form to have both runs and literal words.
+ */
+static struct bitmap *make_bitmap(size_t nr)
+{
+	struct bitmap *bitmap = bitmap_new();
+	size_t i = 0;
+
+	while (i < nr) {
+		size_t len = 1 + next_rand() % 200;
+
+		switch (next_rand() % 3) {
+		case 0:
+			i += len;
+			break;
+		case 1:
+			for (; len && i < nr; len--, i++)
+				bitmap_set(bitmap, i);
+			break;
+		default:
+			for (; len && i < nr; len--, i++)
+				if (next_rand() % 2)
+					bitmap_set(bitmap, i);
+			break;
+		}
+	}
+	return bitmap;
+}
+
+static size_t slow_popcount(struct bitmap *bitmap, size_t nr)
+{
+	size_t i, count = 0;
+
+	for (i = 0; i < nr; i++)
+		count += bitmap_get(bitmap, i);
+	return count;
+}
+
+static void t_ops(size_t nr)
+{
+	struct bitmap *a = make_bitmap(nr), *b = make_bitmap(nr / 2 + 1);
+	struct bitmap *ored = bitmap_dup(a), *ored_ewah = bitmap_dup(b);
+	struct bitmap *and_not = bitmap_dup(a);
+	struct ewah_bitmap *ewah = bitmap_to_ewah(a);
+	size_t i;
+
+	bitmap_or(ored, b);
+	bitmap_or_ewah(ored_ewah, ewah);
+	bitmap_and_not(and_not, b);
+
+	for (i = 0; i < nr; i++) {
+		int want_or = bitmap_get(a, i) || bitmap_get(b, i);
+		int want_and_not = bitmap_get(a, i) && !bitmap_get(b, i);
+
+		if (!check_int(bitmap_get(ored, i), ==, want_or) ||
+		    !check_int(bitmap_get(ored_ewah, i), ==, want_or) ||
+		    !check_int(bitmap_get(and_not, i), ==, want_and_not)) {
+			test_msg("bit %"PRIuMAX" of %"PRIuMAX,
+				 (uintmax_t)i, (uintmax_t)nr);
+			break;
+		}
+	}
+	check(bitmap_equals(ored, ored_ewah));
+
+	check_uint(bitmap_popcount(a), ==, slow_popcount(a, nr));
+	check_uint(ewah_bitmap_popcount(ewah), ==, slow_popcount(a, nr));
+
+	ewah_free(ewah);
+	bitmap_free(and_not);
+	bitmap_free(ored_ewah);
+	bitmap_free(ored);
+	bitmap_free(b);
+	bitmap_free(a);
+}
+
+int cmd_main(int argc UNUSED, const char **argv UNUSED)
+{
+	size_t sizes[] = { 1, 63, 64, 65, 255, 257, 1000, 4099, 100000 };
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		TEST(t_ops(sizes[i]), "operations on %"PRIuMAX"-bit bitmaps (%s)",
+		     (uintmax_t)sizes[i], bitmap_kernels_name());
+
+	return test_done();
+}
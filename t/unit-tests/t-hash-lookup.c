@@ -0,0 +1,149 @@
+#define USE_THE_REPOSITORY_VARIABLE
+
+#include "test-lib.h"
+#include "lib-oid.h"
+#include "hash-lookup.h"
+#include "oid-array.h"
+#include "hex.h"
+
+#define NR_ENTRIES 5000
+
+/* The names are padded to this size to mimic the stride of a .idx v1 */
+#define STRIDE (GIT_MAX_RAWSZ + 4)
+
+static uint32_t rand_state = 1;
+
+static unsigned char next_byte(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return rand_state >> 16;
+}
+
+/*
+ * Fill the first "shared" bytes of each name with the same value to make
+ * names that are anything but uniformly distributed, and the rest with
+ * pseudo-random bytes.
+ */
+static void fill_names(struct object_id *oids, size_t nr, size_t shared)
+{
+	size_t rawsz = the_hash_algo->rawsz;
+
+	for (size_t i = 0; i < nr; i++) {
+		memset(&oids[i], 0, sizeof(oids[i]));
+		oids[i].algo = hash_algo_by_ptr(the_hash_algo);
+		for (size_t j = 0; j < rawsz; j++)
+			oids[i].hash[j] = j < shared ? 0x5a : next_byte();
+	}
+}
+
+static int cmp_oid(const void *a, const void *b)
+{
+	return oidcmp(a, b);
+}
+
+/* The position "oid" would be at in "oids", found the slow way. */
+static size_t linear_pos(const struct object_id *oids, size_t nr,
+			 const struct object_id *oid, int *found)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		int cmp = oidcmp(&oids[i], oid);
+
+		if (cmp >= 0) {
+			*found = !cmp;
+			return i;
+		}
+	}
+	*found = 0;
+	return nr;
+}
+
+static void check_lookup(const struct object_id *oids, size_t nr,
+			 const uint32_t *fanout, const unsigned char *table,
+			 struct oid_array *array, const struct object_id *oid)
+{
+	int found, expect_found, pos;
+	uint32_t result;
+	size_t expect;
+
+	expect = linear_pos(oids, nr, oid, &expect_found);
+
+	found = bsearch_hash(oid->hash, fanout, table, STRIDE, &result);
+	if (!check_int(found, ==, expect_found) ||
+	    !check_uint(result, ==, expect))
+		test_msg("bsearch_hash() of %s", oid_to_hex(oid));
+
+	pos = oid_array_lookup(array, oid);
+	if (!check_int(pos, ==, expect_found ? (int)expect : -1 - (int)expect))
+		test_msg("oid_array_lookup() of %s", oid_to_hex(oid));
+}
+
+static void t_lookup(size_t nr, size_t shared)
+{
+	struct object_id *oids, probe;
+	struct oid_array array = OID_ARRAY_INIT;
+	unsigned char *table;
+	uint32_t fanout[256] = { 0 };
+	size_t i;
+
+	ALLOC_ARRAY(oids, nr);
+	fill_names(oids, nr, shared);
+	QSORT(oids, nr, cmp_oid);
+
+	CALLOC_ARRAY(table, st_mult(nr, STRIDE));
+	for (i = 0; i < nr; i++) {
+		memcpy(table + i * STRIDE, oids[i].hash, the_hash_algo->rawsz);
+		fanout[oids[i].hash[0]]++;
+		oid_array_append(&array, &oids[i]);
+	}
+	for (i = 1; i < 256; i++)
+		fanout[i] += fanout[i - 1];
+	for (i = 0; i < 256; i++)
+		fanout[i] = htonl(fanout[i]);
+
+	for (i = 0; i < nr; i++) {
+		check_lookup(oids, nr, fanout, table, &array, &oids[i]);
+
+		/* just below and above an existing name */
+		oidcpy(&probe, &oids[i]);
+		probe.hash[the_hash_algo->rawsz - 1]--;
+		check_lookup(oids, nr, fanout, table, &array, &probe);
+		probe.hash[the_hash_algo->rawsz - 1] += 2;
+		check_lookup(oids, nr, fanout, table, &array, &probe);
+	}
+
+	fill_names(&probe, 1, 0);
+	check_lookup(oids, nr, fanout, table, &array, &probe);
+	oidclr(&probe, the_hash_algo);
+	check_lookup(oids, nr, fanout, table, &array, &probe);
+	memset(probe.hash, 0xff, the_hash_algo->rawsz);
+	check_lookup(oids, nr, fanout, table, &array, &probe);
+
+	oid_array_clear(&array);
+	free(table);
+	free(oids);
+}
+
+static void setup(void)
+{
+	/* The hash algo is used by bsearch_hash() internally */
+	int algo = init_hash_algo();
+	if (check_int(algo, !=, GIT_HASH_UNKNOWN))
+		repo_set_hash_algo(the_repository, algo);
+}
+
+int cmd_main(int argc UNUSED, const char **argv UNUSED)
+{
+	if (!TEST(setup(), "setup"))
+		test_skip_all("hash algo initialization failed");
+
+	TEST(t_lookup(0, 0), "lookup in an empty table works");
+	TEST(t_lookup(1, 0), "lookup in a single entry table works");
+	TEST(t_lookup(NR_ENTRIES, 0), "lookup of uniform names works");
+	TEST(t_lookup(NR_ENTRIES, 1), "lookup in a single fanout slot works");
+	TEST(t_lookup(NR_ENTRIES, 3), "lookup of names with a long common prefix works");
+	TEST(t_lookup(NR_ENTRIES, 6), "lookup of names sharing the interpolated bytes works");
+
+	return test_done();
+}
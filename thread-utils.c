@@ -111,6 +111,16 @@ int dummy_pthread_init(void *data)
 	return ENOSYS;
 }
 
+int dummy_pthread_once(pthread_once_t *once, void (*fn)(void))
+{
+	/* Without threads, nobody can race us between the check and the call. */
+	if (!*once) {
+		*once = 1;
+		fn();
+	}
+	return 0;
+}
+
 int dummy_pthread_join(pthread_t pthread, void **retval)
 {
 	/*
@@ -42,11 +42,16 @@
 #define pthread_setspecific(key, data)
 #define pthread_getspecific(key) NULL
 
+#define pthread_once_t int
+#define PTHREAD_ONCE_INIT 0
+#define pthread_once(once, fn) dummy_pthread_once(once, fn)
+
 int dummy_pthread_create(pthread_t *pthread, const void *attr,
 			 void *(*fn)(void *), void *data);
 int dummy_pthread_join(pthread_t pthread, void **retval);
 
 int dummy_pthread_init(void *);
+int dummy_pthread_once(pthread_once_t *once, void (*fn)(void));
 
 #endif
 
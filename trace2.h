@@ -560,6 +560,20 @@ enum trace2_counter_id {
 	TRACE2_COUNTER_ID_FSYNC_WRITEOUT_ONLY,
 	TRACE2_COUNTER_ID_FSYNC_HARDWARE_FLUSH,
 
+	/* counts delta base cache lookups and evictions */
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_LOOKUPS,
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HITS,
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISSES,
+	TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICTIONS,
+
+	/* counts pack windows mapped and unmapped by use_pack() */
+	TRACE2_COUNTER_ID_PACK_WINDOW_MAPS,
+	TRACE2_COUNTER_ID_PACK_WINDOW_UNMAPS,
+
+	/* counts pack object filters built, and lookups they turned away */
+	TRACE2_COUNTER_ID_PACK_OID_FILTER_BUILT,
+	TRACE2_COUNTER_ID_PACK_OID_FILTER_SKIPS,
+
 	/* Add additional counter definitions before here. */
 	TRACE2_NUMBER_OF_COUNTERS
 };
@@ -46,6 +46,46 @@ static struct tr2_counter_metadata tr2_counter_metadata[TRACE2_NUMBER_OF_COUNTER
 		.name = "hardware-flush",
 		.want_per_thread_events = 0,
 	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_LOOKUPS] = {
+		.category = "delta-base-cache",
+		.name = "lookups",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_HITS] = {
+		.category = "delta-base-cache",
+		.name = "hits",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_MISSES] = {
+		.category = "delta-base-cache",
+		.name = "misses",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_DELTA_BASE_CACHE_EVICTIONS] = {
+		.category = "delta-base-cache",
+		.name = "evictions",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_PACK_WINDOW_MAPS] = {
+		.category = "pack-windows",
+		.name = "mapped",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_PACK_WINDOW_UNMAPS] = {
+		.category = "pack-windows",
+		.name = "unmapped",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_PACK_OID_FILTER_BUILT] = {
+		.category = "pack-oid-filter",
+		.name = "built",
+		.want_per_thread_events = 0,
+	},
+	[TRACE2_COUNTER_ID_PACK_OID_FILTER_SKIPS] = {
+		.category = "pack-oid-filter",
+		.name = "skips",
+		.want_per_thread_events = 0,
+	},
 
 	/* Add additional metadata before here. */
 };
@@ -78,9 +78,33 @@ typedef struct s_mmbuffer {
 	long size;
 } mmbuffer_t;
 
+/*
+ * Memory handed out to the diff machinery that is reclaimed all at once
+ * with xdl_arena_reset(), so that a caller diffing many pairs of files
+ * in a row does not have to go through malloc() and free() for every
+ * one of them.  After a reset, the next diffs are served from a single
+ * buffer large enough for everything the previous one needed.
+ */
+typedef struct s_xdlarena {
+	char *buf;
+	size_t size, used, wanted;
+	void **extra;
+	long extra_nr, extra_alloc;
+} xdlarena_t;
+
+#define XDL_ARENA_INIT { 0 }
+
 typedef struct s_xpparam {
 	unsigned long flags;
 
+	/*
+	 * If set, the memory needed while preparing and comparing the
+	 * files comes from this arena, which xdl_diff() resets once it
+	 * is done.  It must therefore not be shared with a diff started
+	 * while another is still in progress, e.g. from the callbacks.
+	 */
+	xdlarena_t *arena;
+
 	/* -I<regex> */
 	regex_t **ignore_regex;
 	size_t ignore_regex_nr;
@@ -127,6 +151,9 @@ typedef struct s_bdiffparam {
 void *xdl_mmfile_first(mmfile_t *mmf, long *size);
 long xdl_mmfile_size(mmfile_t *mmf);
 
+void xdl_arena_reset(xdlarena_t *arena);
+void xdl_arena_release(xdlarena_t *arena);
+
 int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	     xdemitconf_t const *xecfg, xdemitcb_t *ecb);
 
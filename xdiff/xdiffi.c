@@ -337,7 +337,7 @@ int xdl_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	 * One is to store the forward path and one to store the backward path.
 	 */
 	ndiags = xe->xdf1.nreff + xe->xdf2.nreff + 3;
-	if (!XDL_ALLOC_ARRAY(kvd, 2 * ndiags + 2)) {
+	if (!XDL_ARENA_ARRAY(xpp->arena, kvd, 2 * ndiags + 2)) {
 
 		xdl_free_env(xe);
 		return -1;
@@ -365,7 +365,7 @@ int xdl_do_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	res = xdl_recs_cmp(&dd1, 0, dd1.nrec, &dd2, 0, dd2.nrec,
 			   kvdf, kvdb, (xpp->flags & XDF_NEED_MINIMAL) != 0,
 			   &xenv);
-	xdl_free(kvd);
+	xdl_arena_free(xpp->arena, kvd);
  out:
 	if (res < 0)
 		xdl_free_env(xe);
@@ -1051,6 +1051,17 @@ static void xdl_mark_ignorable_regex(xdchange_t *xscr, const xdfenv_t *xe,
 	}
 }
 
+/*
+ * Nothing that was prepared for this diff is needed anymore, so
+ * everything it took from the arena can be reused by the next one.
+ */
+static void xdl_done_env(xdfenv_t *xe) {
+
+	xdl_free_env(xe);
+	if (xe->arena)
+		xdl_arena_reset(xe->arena);
+}
+
 int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	     xdemitconf_t const *xecfg, xdemitcb_t *ecb) {
 	xdchange_t *xscr;
@@ -1059,13 +1070,15 @@ int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 
 	if (xdl_do_diff(mf1, mf2, xpp, &xe) < 0) {
 
+		if (xpp->arena)
+			xdl_arena_reset(xpp->arena);
 		return -1;
 	}
 	if (xdl_change_compact(&xe.xdf1, &xe.xdf2, xpp->flags) < 0 ||
 	    xdl_change_compact(&xe.xdf2, &xe.xdf1, xpp->flags) < 0 ||
 	    xdl_build_script(&xe, &xscr) < 0) {
 
-		xdl_free_env(&xe);
+		xdl_done_env(&xe);
 		return -1;
 	}
 	if (xscr) {
@@ -1078,12 +1091,12 @@ int xdl_diff(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 		if (ef(&xe, xscr, ecb, xecfg) < 0) {
 
 			xdl_free_script(xscr);
-			xdl_free_env(&xe);
+			xdl_done_env(&xe);
 			return -1;
 		}
 		xdl_free_script(xscr);
 	}
-	xdl_free_env(&xe);
+	xdl_done_env(&xe);
 
 	return 0;
 }
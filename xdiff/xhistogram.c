@@ -277,7 +277,7 @@ static int find_lcs(xpparam_t const *xpp, xdfenv_t *env,
 		goto cleanup;
 
 	/* lines / 4 + 1 comes from xprepare.c:xdl_prepare_ctx() */
-	if (xdl_cha_init(&index.rcha, sizeof(struct record), count1 / 4 + 1) < 0)
+	if (xdl_cha_init(&index.rcha, sizeof(struct record), count1 / 4 + 1, NULL) < 0)
 		goto cleanup;
 
 	index.ptr_shift = line1;
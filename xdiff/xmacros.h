@@ -68,4 +68,19 @@ do { \
 	(-!((nr) <= (alloc) ||		\
 	    ((p) = xdl_alloc_grow_helper((p), (nr), &(alloc), sizeof(*(p))))))
 
+/* Like XDL_ALLOC_ARRAY(), but from an arena (or the heap if NULL) */
+#define XDL_ARENA_ARRAY(a, p, nr)			\
+	((p) = SIZE_MAX / sizeof(*(p)) >= (size_t)(nr)	\
+		? xdl_arena_alloc((a), (nr) * sizeof(*(p)))	\
+		: NULL)
+
+/* Like XDL_CALLOC_ARRAY(), but from an arena (or the heap if NULL) */
+#define XDL_ARENA_CALLOC_ARRAY(a, p, nr) \
+	((p) = xdl_arena_calloc((a), (nr), sizeof(*(p))))
+
+/* Like XDL_ALLOC_GROW(), but from an arena (or the heap if NULL) */
+#define XDL_ARENA_GROW(a, p, nr, alloc)	\
+	(-!((nr) <= (alloc) ||		\
+	    ((p) = xdl_arena_grow_helper((a), (p), (nr), &(alloc), sizeof(*(p))))))
+
 #endif /* #if !defined(XMACROS_H) */
@@ -48,18 +48,20 @@ typedef struct s_xdlclassifier {
 	long alloc;
 	long count;
 	long flags;
+	xdlarena_t *arena;
 } xdlclassifier_t;
 
 
 
 
-static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags);
+static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags,
+			       xdlarena_t *arena);
 static void xdl_free_classifier(xdlclassifier_t *cf);
 static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t **rhash,
 			       unsigned int hbits, xrecord_t *rec);
 static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_t const *xpp,
 			   xdlclassifier_t *cf, xdfile_t *xdf);
-static void xdl_free_ctx(xdfile_t *xdf);
+static void xdl_free_ctx(xdfile_t *xdf, xdlarena_t *arena);
 static int xdl_clean_mmatch(char const *dis, long i, long s, long e);
 static int xdl_cleanup_records(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xdf2);
 static int xdl_trim_ends(xdfile_t *xdf1, xdfile_t *xdf2);
@@ -68,26 +70,28 @@ static int xdl_optimize_ctxs(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xdf2
 
 
 
-static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags) {
+static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags,
+			       xdlarena_t *arena) {
 	cf->flags = flags;
+	cf->arena = arena;
 
 	cf->hbits = xdl_hashbits((unsigned int) size);
 	cf->hsize = 1 << cf->hbits;
 
-	if (xdl_cha_init(&cf->ncha, sizeof(xdlclass_t), size / 4 + 1) < 0) {
+	if (xdl_cha_init(&cf->ncha, sizeof(xdlclass_t), size / 4 + 1, arena) < 0) {
 
 		return -1;
 	}
-	if (!XDL_CALLOC_ARRAY(cf->rchash, cf->hsize)) {
+	if (!XDL_ARENA_CALLOC_ARRAY(arena, cf->rchash, cf->hsize)) {
 
 		xdl_cha_free(&cf->ncha);
 		return -1;
 	}
 
 	cf->alloc = size;
-	if (!XDL_ALLOC_ARRAY(cf->rcrecs, cf->alloc)) {
+	if (!XDL_ARENA_ARRAY(arena, cf->rcrecs, cf->alloc)) {
 
-		xdl_free(cf->rchash);
+		xdl_arena_free(arena, cf->rchash);
 		xdl_cha_free(&cf->ncha);
 		return -1;
 	}
@@ -100,8 +104,8 @@ static int xdl_init_classifier(xdlclassifier_t *cf, long size, long flags) {
 
 static void xdl_free_classifier(xdlclassifier_t *cf) {
 
-	xdl_free(cf->rcrecs);
-	xdl_free(cf->rchash);
+	xdl_arena_free(cf->arena, cf->rcrecs);
+	xdl_arena_free(cf->arena, cf->rchash);
 	xdl_cha_free(&cf->ncha);
 }
 
@@ -126,7 +130,7 @@ static int xdl_classify_record(unsigned int pass, xdlclassifier_t *cf, xrecord_t
 			return -1;
 		}
 		rcrec->idx = cf->count++;
-		if (XDL_ALLOC_GROW(cf->rcrecs, cf->count, cf->alloc))
+		if (XDL_ARENA_GROW(cf->arena, cf->rcrecs, cf->count, cf->alloc))
 				return -1;
 		cf->rcrecs[rcrec->idx] = rcrec;
 		rcrec->line = line;
@@ -161,6 +165,7 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	unsigned long *ha;
 	char *rchg;
 	long *rindex;
+	xdlarena_t *arena = xpp->arena;
 
 	ha = NULL;
 	rindex = NULL;
@@ -168,14 +173,14 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	rhash = NULL;
 	recs = NULL;
 
-	if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec / 4 + 1) < 0)
+	if (xdl_cha_init(&xdf->rcha, sizeof(xrecord_t), narec / 4 + 1, arena) < 0)
 		goto abort;
-	if (!XDL_ALLOC_ARRAY(recs, narec))
+	if (!XDL_ARENA_ARRAY(arena, recs, narec))
 		goto abort;
 
 	hbits = xdl_hashbits((unsigned int) narec);
 	hsize = 1 << hbits;
-	if (!XDL_CALLOC_ARRAY(rhash, hsize))
+	if (!XDL_ARENA_CALLOC_ARRAY(arena, rhash, hsize))
 		goto abort;
 
 	nrec = 0;
@@ -183,7 +188,7 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 		for (top = blk + bsize; cur < top; ) {
 			prev = cur;
 			hav = xdl_hash_record(&cur, top, xpp->flags);
-			if (XDL_ALLOC_GROW(recs, nrec + 1, narec))
+			if (XDL_ARENA_GROW(arena, recs, nrec + 1, narec))
 				goto abort;
 			if (!(crec = xdl_cha_alloc(&xdf->rcha)))
 				goto abort;
@@ -196,14 +201,14 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 		}
 	}
 
-	if (!XDL_CALLOC_ARRAY(rchg, nrec + 2))
+	if (!XDL_ARENA_CALLOC_ARRAY(arena, rchg, nrec + 2))
 		goto abort;
 
 	if ((XDF_DIFF_ALG(xpp->flags) != XDF_PATIENCE_DIFF) &&
 	    (XDF_DIFF_ALG(xpp->flags) != XDF_HISTOGRAM_DIFF)) {
-		if (!XDL_ALLOC_ARRAY(rindex, nrec + 1))
+		if (!XDL_ARENA_ARRAY(arena, rindex, nrec + 1))
 			goto abort;
-		if (!XDL_ALLOC_ARRAY(ha, nrec + 1))
+		if (!XDL_ARENA_ARRAY(arena, ha, nrec + 1))
 			goto abort;
 	}
 
@@ -221,23 +226,23 @@ static int xdl_prepare_ctx(unsigned int pass, mmfile_t *mf, long narec, xpparam_
 	return 0;
 
 abort:
-	xdl_free(ha);
-	xdl_free(rindex);
-	xdl_free(rchg);
-	xdl_free(rhash);
-	xdl_free(recs);
+	xdl_arena_free(arena, ha);
+	xdl_arena_free(arena, rindex);
+	xdl_arena_free(arena, rchg);
+	xdl_arena_free(arena, rhash);
+	xdl_arena_free(arena, recs);
 	xdl_cha_free(&xdf->rcha);
 	return -1;
 }
 
 
-static void xdl_free_ctx(xdfile_t *xdf) {
+static void xdl_free_ctx(xdfile_t *xdf, xdlarena_t *arena) {
 
-	xdl_free(xdf->rhash);
-	xdl_free(xdf->rindex);
-	xdl_free(xdf->rchg - 1);
-	xdl_free(xdf->ha);
-	xdl_free(xdf->recs);
+	xdl_arena_free(arena, xdf->rhash);
+	xdl_arena_free(arena, xdf->rindex);
+	xdl_arena_free(arena, xdf->rchg - 1);
+	xdl_arena_free(arena, xdf->ha);
+	xdl_arena_free(arena, xdf->recs);
 	xdl_cha_free(&xdf->rcha);
 }
 
@@ -248,6 +253,7 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	xdlclassifier_t cf;
 
 	memset(&cf, 0, sizeof(cf));
+	xe->arena = xpp->arena;
 
 	/*
 	 * For histogram diff, we can afford a smaller sample size and
@@ -262,7 +268,7 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	enl1 = xdl_guess_lines(mf1, sample) + 1;
 	enl2 = xdl_guess_lines(mf2, sample) + 1;
 
-	if (xdl_init_classifier(&cf, enl1 + enl2 + 1, xpp->flags) < 0)
+	if (xdl_init_classifier(&cf, enl1 + enl2 + 1, xpp->flags, xpp->arena) < 0)
 		return -1;
 
 	if (xdl_prepare_ctx(1, mf1, enl1, xpp, &cf, &xe->xdf1) < 0) {
@@ -272,7 +278,7 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	}
 	if (xdl_prepare_ctx(2, mf2, enl2, xpp, &cf, &xe->xdf2) < 0) {
 
-		xdl_free_ctx(&xe->xdf1);
+		xdl_free_ctx(&xe->xdf1, xe->arena);
 		xdl_free_classifier(&cf);
 		return -1;
 	}
@@ -281,8 +287,8 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 	    (XDF_DIFF_ALG(xpp->flags) != XDF_HISTOGRAM_DIFF) &&
 	    xdl_optimize_ctxs(&cf, &xe->xdf1, &xe->xdf2) < 0) {
 
-		xdl_free_ctx(&xe->xdf2);
-		xdl_free_ctx(&xe->xdf1);
+		xdl_free_ctx(&xe->xdf2, xe->arena);
+		xdl_free_ctx(&xe->xdf1, xe->arena);
 		xdl_free_classifier(&cf);
 		return -1;
 	}
@@ -295,8 +301,8 @@ int xdl_prepare_env(mmfile_t *mf1, mmfile_t *mf2, xpparam_t const *xpp,
 
 void xdl_free_env(xdfenv_t *xe) {
 
-	xdl_free_ctx(&xe->xdf2);
-	xdl_free_ctx(&xe->xdf1);
+	xdl_free_ctx(&xe->xdf2, xe->arena);
+	xdl_free_ctx(&xe->xdf1, xe->arena);
 }
 
 
@@ -369,7 +375,7 @@ static int xdl_cleanup_records(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xd
 	xdlclass_t *rcrec;
 	char *dis, *dis1, *dis2;
 
-	if (!XDL_CALLOC_ARRAY(dis, xdf1->nrec + xdf2->nrec + 2))
+	if (!XDL_ARENA_CALLOC_ARRAY(cf->arena, dis, xdf1->nrec + xdf2->nrec + 2))
 		return -1;
 	dis1 = dis;
 	dis2 = dis1 + xdf1->nrec + 1;
@@ -414,7 +420,7 @@ static int xdl_cleanup_records(xdlclassifier_t *cf, xdfile_t *xdf1, xdfile_t *xd
 	}
 	xdf2->nreff = nreff;
 
-	xdl_free(dis);
+	xdl_arena_free(cf->arena, dis);
 
 	return 0;
 }
@@ -32,6 +32,7 @@ typedef struct s_chanode {
 
 typedef struct s_chastore {
 	chanode_t *head, *tail;
+	xdlarena_t *arena;
 	long isize, nsize;
 	chanode_t *ancur;
 	chanode_t *sncur;
@@ -60,6 +61,7 @@ typedef struct s_xdfile {
 
 typedef struct s_xdfenv {
 	xdfile_t xdf1, xdf2;
+	xdlarena_t *arena;
 } xdfenv_t;
 
 
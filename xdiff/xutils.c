@@ -71,9 +71,10 @@ long xdl_mmfile_size(mmfile_t *mmf)
 }
 
 
-int xdl_cha_init(chastore_t *cha, long isize, long icount) {
+int xdl_cha_init(chastore_t *cha, long isize, long icount, xdlarena_t *arena) {
 
 	cha->head = cha->tail = NULL;
+	cha->arena = arena;
 	cha->isize = isize;
 	cha->nsize = icount * isize;
 	cha->ancur = cha->sncur = NULL;
@@ -88,7 +89,7 @@ void xdl_cha_free(chastore_t *cha) {
 
 	for (cur = cha->head; (tmp = cur) != NULL;) {
 		cur = cur->next;
-		xdl_free(tmp);
+		xdl_arena_free(cha->arena, tmp);
 	}
 }
 
@@ -98,7 +99,8 @@ void *xdl_cha_alloc(chastore_t *cha) {
 	void *data;
 
 	if (!(ancur = cha->ancur) || ancur->icurr == cha->nsize) {
-		if (!(ancur = (chanode_t *) xdl_malloc(sizeof(chanode_t) + cha->nsize))) {
+		if (!(ancur = (chanode_t *) xdl_arena_alloc(cha->arena,
+							     sizeof(chanode_t) + cha->nsize))) {
 
 			return NULL;
 		}
@@ -294,20 +296,52 @@ static unsigned long xdl_hash_record_with_whitespace(char const **data,
 	return ha;
 }
 
+/*
+ * Hash a line eight bytes at a time.  The value only needs to be
+ * consistent within a single diff, so it is fine for it to depend on
+ * the byte order of the machine.  The whitespace-ignoring variant above
+ * must still look at every byte, but when all bytes are significant we
+ * can let memchr() find the end of the line and fold whole words into
+ * the hash, which is considerably faster than the byte-wise loop.
+ */
+static unsigned long xdl_hash_bytes(char const *ptr, size_t len)
+{
+	uint64_t ha = 0x9e3779b97f4a7c15ULL ^ len;
+	uint64_t w;
+
+	for (; len >= sizeof(w); ptr += sizeof(w), len -= sizeof(w)) {
+		memcpy(&w, ptr, sizeof(w));
+		ha = (ha ^ w) * 0x9fb21c651e98df25ULL;
+		ha ^= ha >> 29;
+	}
+	if (len) {
+		w = 0;
+		memcpy(&w, ptr, len);
+		ha = (ha ^ w) * 0x9fb21c651e98df25ULL;
+		ha ^= ha >> 29;
+	}
+
+	/* XDL_HASHLONG() uses the low bits, so make them depend on all of them */
+	ha ^= ha >> 33;
+	ha *= 0xff51afd7ed558ccdULL;
+	ha ^= ha >> 33;
+	ha *= 0xc4ceb9fe1a85ec53ULL;
+	ha ^= ha >> 33;
+
+	return (unsigned long) ha;
+}
+
 unsigned long xdl_hash_record(char const **data, char const *top, long flags) {
-	unsigned long ha = 5381;
 	char const *ptr = *data;
+	char const *eol;
 
 	if (flags & XDF_WHITESPACE_FLAGS)
 		return xdl_hash_record_with_whitespace(data, top, flags);
 
-	for (; ptr < top && *ptr != '\n'; ptr++) {
-		ha += (ha << 5);
-		ha ^= (unsigned long) *ptr;
-	}
-	*data = ptr < top ? ptr + 1: ptr;
+	eol = memchr(ptr, '\n', top - ptr);
+	*data = eol ? eol + 1 : top;
 
-	return ha;
+	return xdl_hash_bytes(ptr, (eol ? eol : top) - ptr);
 }
 
 unsigned int xdl_hashbits(unsigned int size) {
@@ -449,3 +483,106 @@ void* xdl_alloc_grow_helper(void *p, long nr, long *alloc, size_t size)
 	}
 	return tmp;
 }
+
+/* Keep everything we hand out suitably aligned for any type */
+#define XDL_ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+void *xdl_arena_alloc(xdlarena_t *arena, size_t size)
+{
+	void *p;
+
+	if (!arena)
+		return xdl_malloc(size);
+
+	size = XDL_ARENA_ALIGN(size);
+	arena->wanted += size;
+	if (size <= arena->size - arena->used) {
+		p = arena->buf + arena->used;
+		arena->used += size;
+		return p;
+	}
+
+	/*
+	 * Does not fit; use the heap for now and make the buffer large
+	 * enough for all of this at the next reset.
+	 */
+	if (XDL_ALLOC_GROW(arena->extra, arena->extra_nr + 1, arena->extra_alloc))
+		return NULL;
+	if (!(p = xdl_malloc(size)))
+		return NULL;
+	arena->extra[arena->extra_nr++] = p;
+	return p;
+}
+
+void *xdl_arena_calloc(xdlarena_t *arena, size_t nr, size_t size)
+{
+	void *p;
+
+	if (!arena)
+		return xdl_calloc(nr, size);
+	if (size && SIZE_MAX / size < nr)
+		return NULL;
+	if ((p = xdl_arena_alloc(arena, nr * size)))
+		memset(p, 0, nr * size);
+	return p;
+}
+
+void xdl_arena_free(xdlarena_t *arena, void *p)
+{
+	/* memory from an arena is only reclaimed by xdl_arena_reset() */
+	if (!arena)
+		xdl_free(p);
+}
+
+void *xdl_arena_grow_helper(xdlarena_t *arena, void *p, long nr, long *alloc,
+			    size_t size)
+{
+	void *tmp = NULL;
+	size_t n;
+
+	if (!arena)
+		return xdl_alloc_grow_helper(p, nr, alloc, size);
+
+	n = ((LONG_MAX - 16) / 2 >= *alloc) ? 2 * *alloc + 16 : LONG_MAX;
+	if (nr > n)
+		n = nr;
+	if (SIZE_MAX / size >= n)
+		tmp = xdl_arena_alloc(arena, n * size);
+	if (tmp) {
+		if (p)
+			memcpy(tmp, p, *alloc * size);
+		*alloc = n;
+	} else {
+		*alloc = 0;
+	}
+	return tmp;
+}
+
+void xdl_arena_reset(xdlarena_t *arena)
+{
+	long i;
+
+	for (i = 0; i < arena->extra_nr; i++)
+		xdl_free(arena->extra[i]);
+	arena->extra_nr = 0;
+
+	if (arena->wanted > arena->size) {
+		xdl_free(arena->buf);
+		arena->size = arena->wanted;
+		arena->buf = xdl_malloc(arena->size);
+		if (!arena->buf)
+			arena->size = 0;
+	}
+	arena->used = arena->wanted = 0;
+}
+
+void xdl_arena_release(xdlarena_t *arena)
+{
+	long i;
+
+	for (i = 0; i < arena->extra_nr; i++)
+		xdl_free(arena->extra[i]);
+	xdl_free(arena->extra);
+	xdl_free(arena->buf);
+	memset(arena, 0, sizeof(*arena));
+}
@@ -28,7 +28,7 @@
 long xdl_bogosqrt(long n);
 int xdl_emit_diffrec(char const *rec, long size, char const *pre, long psize,
 		     xdemitcb_t *ecb);
-int xdl_cha_init(chastore_t *cha, long isize, long icount);
+int xdl_cha_init(chastore_t *cha, long isize, long icount, xdlarena_t *arena);
 void xdl_cha_free(chastore_t *cha);
 void *xdl_cha_alloc(chastore_t *cha);
 long xdl_guess_lines(mmfile_t *mf, long sample);
@@ -45,4 +45,13 @@ int xdl_fall_back_diff(xdfenv_t *diff_env, xpparam_t const *xpp,
 /* Do not call this function, use XDL_ALLOC_GROW instead */
 void* xdl_alloc_grow_helper(void* p, long nr, long* alloc, size_t size);
 
+/* These fall back to the heap when "arena" is NULL */
+void *xdl_arena_alloc(xdlarena_t *arena, size_t size);
+void *xdl_arena_calloc(xdlarena_t *arena, size_t nr, size_t size);
+void xdl_arena_free(xdlarena_t *arena, void *p);
+
+/* Do not call this function, use XDL_ARENA_GROW instead */
+void *xdl_arena_grow_helper(xdlarena_t *arena, void *p, long nr, long *alloc,
+			    size_t size);
+
 #endif /* #if !defined(XUTILS_H) */